@@ -60,6 +60,11 @@ qint64 ChildProcessContext::pid() const
 #endif
 }
 
+bool ChildProcessContext::crashed() const
+{
+    return m_proc.exitStatus() == QProcess::CrashExit;
+}
+
 void ChildProcessContext::kill(const QString& signal)
 {
     // TODO: it would be nice to be able to handle more signals
@@ -101,9 +106,12 @@ qint64 ChildProcessContext::_write(const QString& chunk, const QString& encoding
         }
     }
 
-    qint64 bytesWritten = m_proc.write(codec->fromUnicode(chunk));
+    return writeBytes(codec->fromUnicode(chunk));
+}
 
-    return bytesWritten;
+qint64 ChildProcessContext::writeBytes(const QByteArray& bytes)
+{
+    return m_proc.write(bytes);
 }
 
 void ChildProcessContext::_close()
@@ -45,18 +45,21 @@
 class ChildProcessContext : public QObject {
     Q_OBJECT
     Q_PROPERTY(qint64 pid READ pid)
+    Q_PROPERTY(bool crashed READ crashed)
 
 public:
     explicit ChildProcessContext(QObject* parent = 0);
     virtual ~ChildProcessContext();
 
     qint64 pid() const;
+    bool crashed() const;
     Q_INVOKABLE void kill(const QString& signal = "SIGTERM");
 
     Q_INVOKABLE void _setEncoding(const QString& encoding);
     Q_INVOKABLE bool _start(const QString& cmd, const QStringList& args);
 
     Q_INVOKABLE qint64 _write(const QString& chunk, const QString& encoding);
+    qint64 writeBytes(const QByteArray& bytes);
     Q_INVOKABLE void _close();
 
 signals:
@@ -60,6 +60,17 @@ static const struct QCommandLineConfigEntry flags[] = {
     { QCommandLine::Option, '\0', "offline-storage-quota", "Sets the maximum size of the offline storage (in KB)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "local-to-remote-url-access", "Allows local content to access remote URL: 'true' or 'false' (default)", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "max-disk-cache-size", "Limits the size of the disk cache (in KB)", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "max-connections", "Limits the number of requests going on at once for all the pages, 0 (default) for no limit", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "max-connections-per-host", "Limits the number of requests going on at once to each host, 0 (default) for Qt's own limit", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "host-resolver-rules", "Sends the requests to some hosts elsewhere, as in 'MAP *.example.com 127.0.0.1:8080, EXCLUDE www.example.com'", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "dns-cache-ttl", "Keeps the hosts used resolved for this many seconds, 0 (default) not to", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "dns-prefetch", "Hosts to resolve at start, comma separated, kept resolved as long as '--dns-cache-ttl' says", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "http2", "Lets HTTPS requests use HTTP/2 (needs Qt 5.8): 'true' or 'false' (default)", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "http2-cleartext", "Lets plain HTTP requests upgrade to HTTP/2, h2c (needs Qt 5.8): 'true' or 'false' (default)", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "coalesce-requests", "Lets identical GET requests going on at once from all the pages share one download: 'true' or 'false' (default)", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "network-archive", "Specifies an archive file to record network responses to, or replay them from", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "network-archive-mode", "Sets what to do with the network archive: 'replay' (default) to serve responses from it only, or 'record'", QCommandLine::Optional },
+    { QCommandLine::Option, '\0', "memory-cache-size", "Sets the size of an in-memory cache shared by all pages (in KB), 0 (default) to disable", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "output-encoding", "Sets the encoding for the terminal output, default is 'utf8'", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "remote-debugger-port", "Starts the script in a debug harness and listens on the specified port", QCommandLine::Optional },
     { QCommandLine::Option, '\0', "remote-debugger-autorun", "Runs the script in the debugger immediately: 'true' or 'false' (default)", QCommandLine::Optional },
@@ -248,6 +259,116 @@ void Config::setDiskCachePath(const QString& value)
     m_diskCachePath = dir.absolutePath();
 }
 
+int Config::maxMemoryCacheSize() const
+{
+    return m_maxMemoryCacheSize;
+}
+
+void Config::setMaxMemoryCacheSize(int maxMemoryCacheSize)
+{
+    m_maxMemoryCacheSize = maxMemoryCacheSize;
+}
+
+QString Config::networkArchive() const
+{
+    return m_networkArchive;
+}
+
+void Config::setNetworkArchive(const QString& value)
+{
+    m_networkArchive = value;
+}
+
+QString Config::networkArchiveMode() const
+{
+    return m_networkArchiveMode;
+}
+
+void Config::setNetworkArchiveMode(const QString& value)
+{
+    m_networkArchiveMode = value.toLower();
+}
+
+int Config::maxConnections() const
+{
+    return m_maxConnections;
+}
+
+void Config::setMaxConnections(int maxConnections)
+{
+    m_maxConnections = maxConnections;
+}
+
+int Config::maxConnectionsPerHost() const
+{
+    return m_maxConnectionsPerHost;
+}
+
+void Config::setMaxConnectionsPerHost(int maxConnectionsPerHost)
+{
+    m_maxConnectionsPerHost = maxConnectionsPerHost;
+}
+
+bool Config::coalesceRequests() const
+{
+    return m_coalesceRequests;
+}
+
+void Config::setCoalesceRequests(const bool value)
+{
+    m_coalesceRequests = value;
+}
+
+bool Config::http2Enabled() const
+{
+    return m_http2Enabled;
+}
+
+void Config::setHttp2Enabled(const bool value)
+{
+    m_http2Enabled = value;
+}
+
+bool Config::http2CleartextEnabled() const
+{
+    return m_http2CleartextEnabled;
+}
+
+void Config::setHttp2CleartextEnabled(const bool value)
+{
+    m_http2CleartextEnabled = value;
+}
+
+QString Config::hostResolverRules() const
+{
+    return m_hostResolverRules;
+}
+
+void Config::setHostResolverRules(const QString& value)
+{
+    m_hostResolverRules = value;
+}
+
+int Config::dnsCacheTtl() const
+{
+    return m_dnsCacheTtl;
+}
+
+void Config::setDnsCacheTtl(int dnsCacheTtl)
+{
+    m_dnsCacheTtl = dnsCacheTtl;
+}
+
+QString Config::dnsPrefetch() const
+{
+    return m_dnsPrefetch;
+}
+
+void Config::setDnsPrefetch(const QString& value)
+{
+    m_dnsPrefetch = value;
+}
+
 bool Config::ignoreSslErrors() const
 {
     return m_ignoreSslErrors;
@@ -487,6 +608,17 @@ void Config::resetToDefaults()
     m_diskCacheEnabled = false;
     m_maxDiskCacheSize = -1;
     m_diskCachePath = QString();
+    m_maxMemoryCacheSize = 0;
+    m_networkArchive = QString();
+    m_networkArchiveMode = "replay";
+    m_maxConnections = 0;
+    m_maxConnectionsPerHost = 0;
+    m_coalesceRequests = false;
+    m_http2Enabled = false;
+    m_http2CleartextEnabled = false;
+    m_hostResolverRules = QString();
+    m_dnsCacheTtl = 0;
+    m_dnsPrefetch = QString();
     m_ignoreSslErrors = false;
     m_localUrlAccessEnabled = true;
     m_localToRemoteUrlAccessEnabled = false;
@@ -586,8 +718,11 @@ void Config::handleOption(const QString& option, const QVariant& value)
     bool boolValue = false;
 
     QStringList booleanFlags;
+    booleanFlags << "coalesce-requests";
     booleanFlags << "debug";
     booleanFlags << "disk-cache";
+    booleanFlags << "http2";
+    booleanFlags << "http2-cleartext";
     booleanFlags << "ignore-ssl-errors";
     booleanFlags << "load-images";
     booleanFlags << "local-url-access";
@@ -658,6 +793,54 @@ void Config::handleOption(const QString& option, const QVariant& value)
         setMaxDiskCacheSize(value.toInt());
     }
 
+    if (option == "max-connections") {
+        setMaxConnections(value.toInt());
+    }
+
+    if (option == "max-connections-per-host") {
+        setMaxConnectionsPerHost(value.toInt());
+    }
+
+    if (option == "coalesce-requests") {
+        setCoalesceRequests(boolValue);
+    }
+
+    if (option == "http2") {
+        setHttp2Enabled(boolValue);
+    }
+
+    if (option == "http2-cleartext") {
+        setHttp2CleartextEnabled(boolValue);
+    }
+
+    if (option == "host-resolver-rules") {
+        setHostResolverRules(value.toString());
+    }
+
+    if (option == "dns-cache-ttl") {
+        setDnsCacheTtl(value.toInt());
+    }
+
+    if (option == "dns-prefetch") {
+        setDnsPrefetch(value.toString());
+    }
+
+    if (option == "network-archive") {
+        setNetworkArchive(value.toString());
+    }
+
+    if (option == "network-archive-mode") {
+        if (value != "record" && value != "replay") {
+            setUnknownOption(QString("Invalid values for '%1' option.").arg(option));
+            return;
+        }
+        setNetworkArchiveMode(value.toString());
+    }
+
+    if (option == "memory-cache-size") {
+        setMaxMemoryCacheSize(value.toInt());
+    }
+
     if (option == "output-encoding") {
         setOutputEncoding(value.toString());
     }
@@ -44,6 +44,17 @@ class Config : public QObject {
     Q_PROPERTY(bool diskCacheEnabled READ diskCacheEnabled WRITE setDiskCacheEnabled)
     Q_PROPERTY(int maxDiskCacheSize READ maxDiskCacheSize WRITE setMaxDiskCacheSize)
     Q_PROPERTY(QString diskCachePath READ diskCachePath WRITE setDiskCachePath)
+    Q_PROPERTY(int maxMemoryCacheSize READ maxMemoryCacheSize WRITE setMaxMemoryCacheSize)
+    Q_PROPERTY(QString networkArchive READ networkArchive WRITE setNetworkArchive)
+    Q_PROPERTY(QString networkArchiveMode READ networkArchiveMode WRITE setNetworkArchiveMode)
+    Q_PROPERTY(int maxConnections READ maxConnections WRITE setMaxConnections)
+    Q_PROPERTY(int maxConnectionsPerHost READ maxConnectionsPerHost WRITE setMaxConnectionsPerHost)
+    Q_PROPERTY(bool coalesceRequests READ coalesceRequests WRITE setCoalesceRequests)
+    Q_PROPERTY(bool http2Enabled READ http2Enabled WRITE setHttp2Enabled)
+    Q_PROPERTY(bool http2CleartextEnabled READ http2CleartextEnabled WRITE setHttp2CleartextEnabled)
+    Q_PROPERTY(QString hostResolverRules READ hostResolverRules WRITE setHostResolverRules)
+    Q_PROPERTY(int dnsCacheTtl READ dnsCacheTtl WRITE setDnsCacheTtl)
+    Q_PROPERTY(QString dnsPrefetch READ dnsPrefetch WRITE setDnsPrefetch)
     Q_PROPERTY(bool ignoreSslErrors READ ignoreSslErrors WRITE setIgnoreSslErrors)
     Q_PROPERTY(bool localUrlAccessEnabled READ localUrlAccessEnabled WRITE setLocalUrlAccessEnabled)
     Q_PROPERTY(bool localToRemoteUrlAccessEnabled READ localToRemoteUrlAccessEnabled WRITE setLocalToRemoteUrlAccessEnabled)
@@ -103,6 +114,39 @@ public:
     QString diskCachePath() const;
     void setDiskCachePath(const QString& value);
 
+    int maxMemoryCacheSize() const;
+    void setMaxMemoryCacheSize(int maxMemoryCacheSize);
+
+    QString networkArchive() const;
+    void setNetworkArchive(const QString& value);
+
+    QString networkArchiveMode() const;
+    void setNetworkArchiveMode(const QString& value);
+
+    int maxConnections() const;
+    void setMaxConnections(int maxConnections);
+
+    int maxConnectionsPerHost() const;
+    void setMaxConnectionsPerHost(int maxConnectionsPerHost);
+
+    bool coalesceRequests() const;
+    void setCoalesceRequests(const bool value);
+
+    bool http2Enabled() const;
+    void setHttp2Enabled(const bool value);
+
+    bool http2CleartextEnabled() const;
+    void setHttp2CleartextEnabled(const bool value);
+
+    QString hostResolverRules() const;
+    void setHostResolverRules(const QString& value);
+
+    int dnsCacheTtl() const;
+    void setDnsCacheTtl(int dnsCacheTtl);
+
+    QString dnsPrefetch() const;
+    void setDnsPrefetch(const QString& value);
+
     bool ignoreSslErrors() const;
     void setIgnoreSslErrors(const bool value);
 
@@ -210,6 +254,17 @@ private:
     bool m_diskCacheEnabled;
     int m_maxDiskCacheSize;
     QString m_diskCachePath;
+    int m_maxMemoryCacheSize;
+    QString m_networkArchive;
+    QString m_networkArchiveMode;
+    int m_maxConnections;
+    int m_maxConnectionsPerHost;
+    bool m_coalesceRequests;
+    bool m_http2Enabled;
+    bool m_http2CleartextEnabled;
+    QString m_hostResolverRules;
+    int m_dnsCacheTtl;
+    QString m_dnsPrefetch;
     bool m_ignoreSslErrors;
     bool m_localUrlAccessEnabled;
     bool m_localToRemoteUrlAccessEnabled;
@@ -39,6 +39,7 @@
 
 #define HTTP_HEADER_CONTENT_LENGTH "content-length"
 #define HTTP_HEADER_CONTENT_TYPE "content-type"
+#define HTTP_HEADER_TRANSFER_ENCODING "transfer-encoding"
 
 #define JAVASCRIPT_SOURCE_PLATFORM_URL "phantomjs://platform/%1"
 #define JAVASCRIPT_SOURCE_CODE_URL "phantomjs://code/%1"
@@ -64,9 +65,16 @@
 #define PAGE_SETTINGS_PASSWORD "password"
 #define PAGE_SETTINGS_MAX_AUTH_ATTEMPTS "maxAuthAttempts"
 #define PAGE_SETTINGS_RESOURCE_TIMEOUT "resourceTimeout"
+#define PAGE_SETTINGS_RESOURCE_FIRST_BYTE_TIMEOUT "resourceFirstByteTimeout"
 #define PAGE_SETTINGS_WEB_SECURITY_ENABLED "webSecurityEnabled"
 #define PAGE_SETTINGS_JS_CAN_OPEN_WINDOWS "javascriptCanOpenWindows"
 #define PAGE_SETTINGS_JS_CAN_CLOSE_WINDOWS "javascriptCanCloseWindows"
 #define PAGE_SETTINGS_DPI "dpi"
+#define PAGE_SETTINGS_RESOURCE_PRIORITIES "resourcePriorities"
+#define PAGE_SETTINGS_NETWORK_IDLE_TIME "networkIdleTime"
+#define PAGE_SETTINGS_NETWORK_IDLE_MAX_INFLIGHT "networkIdleMaxInflight"
+#define PAGE_SETTINGS_POST_DATA_CAPTURE_SIZE "postDataCaptureSize"
+#define PAGE_SETTINGS_HTTP2_ENABLED "http2Enabled"
+#define PAGE_SETTINGS_HTTP2_CLEARTEXT_ENABLED "http2CleartextEnabled"
 
 #endif // CONSTS_H
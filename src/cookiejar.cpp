@@ -30,16 +30,26 @@
 
 #include "cookiejar.h"
 #include "config.h"
+#include "cookielog.h"
 #include "phantom.h"
 
 #include <QDataStream>
 #include <QDateTime>
+#include <QFile>
 #include <QSettings>
 #include <QTimer>
 
+#include <algorithm>
+
 #define COOKIE_JAR_VERSION 1
 
-// Operators needed for Cookie Serialization
+// Changes are written at most this often, in milliseconds
+#define COOKIE_JAR_SAVE_DELAY 1000
+
+// Changes other processes make to the file are picked up at most this often, in milliseconds
+#define COOKIE_JAR_SYNC_INTERVAL 250
+
+// Operators needed to read the QSettings files of earlier versions
 QT_BEGIN_NAMESPACE
 QDataStream& operator<<(QDataStream& stream, const QList<QNetworkCookie>& list)
 {
@@ -82,17 +92,54 @@ QDataStream& operator>>(QDataStream& stream, QList<QNetworkCookie>& list)
 }
 QT_END_NAMESPACE
 
+// Same rules as QNetworkCookieJar::cookiesForUrl
+static bool isParentDomain(const QString& domain, const QString& reference)
+{
+    if (!reference.startsWith(QLatin1Char('.'))) {
+        return domain == reference;
+    }
+    return domain.endsWith(reference) || domain == reference.mid(1);
+}
+
+static bool isParentPath(const QString& path, const QString& reference)
+{
+    if ((path.isEmpty() && reference == QLatin1String("/")) || path.startsWith(reference)) {
+        return path.length() == reference.length()
+            || reference.endsWith(QLatin1Char('/'))
+            || path.at(reference.length()) == QLatin1Char('/');
+    }
+    return false;
+}
+
+static bool hasLongerPath(const QNetworkCookie& a, const QNetworkCookie& b)
+{
+    return a.path().length() > b.path().length();
+}
+
+static QString domainKey(const QString& domain)
+{
+    return (domain.startsWith(QLatin1Char('.')) ? domain.mid(1) : domain).toLower();
+}
+
 // public:
 CookieJar::CookieJar(QString cookiesFile, QObject* parent)
     : QNetworkCookieJar(parent)
+    , m_cookieCount(0)
+    , m_nextSequence(0)
+    , m_cookieLog(Q_NULLPTR)
+    , m_rewriteNeeded(false)
     , m_enabled(true)
 {
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(COOKIE_JAR_SAVE_DELAY);
+    connect(&m_saveTimer, SIGNAL(timeout()), this, SLOT(save()));
+
     if (cookiesFile == "") {
-        m_cookieStorage = 0;
         qDebug() << "CookieJar - Created but will not store cookies (use option '--cookies-file=<filename>' to enable persistent cookie storage)";
     } else {
-        m_cookieStorage = new QSettings(cookiesFile, QSettings::IniFormat, this);
+        m_cookieLog = new CookieLog(cookiesFile);
         load();
+        m_cookieLog->addUser();
         qDebug() << "CookieJar - Created and will store cookies in:" << cookiesFile;
     }
 }
@@ -100,9 +147,13 @@ CookieJar::CookieJar(QString cookiesFile, QObject* parent)
 // private:
 CookieJar::~CookieJar()
 {
-    // On destruction, before saving, clear all the session cookies
-    purgeSessionCookies();
+    // On destruction, before saving, clear all the session cookies;
+    // those in a shared file last until the last process using it is done
+    if (!m_cookieLog || m_cookieLog->releaseUser()) {
+        purgeSessionCookies();
+    }
     save();
+    delete m_cookieLog;
 }
 
 bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const QUrl& url)
@@ -111,7 +162,6 @@ bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const
     // Update cookies in memory
     if (isEnabled()) {
         isCookieAdded = QNetworkCookieJar::setCookiesFromUrl(cookieList, url);
-        save();
     }
     // No changes occurred
     return isCookieAdded;
@@ -119,11 +169,77 @@ bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie>& cookieList, const
 
 QList<QNetworkCookie> CookieJar::cookiesForUrl(const QUrl& url) const
 {
-    if (isEnabled()) {
-        return QNetworkCookieJar::cookiesForUrl(url);
-    }
+    QList<QNetworkCookie> result;
     // The CookieJar is disabled: don't return any cookie
-    return QList<QNetworkCookie>();
+    if (!isEnabled()) {
+        return result;
+    }
+
+    // Pick up what other processes sharing the file did
+    const_cast<CookieJar*>(this)->syncWithFile();
+    if (m_cookieCount == 0) {
+        return result;
+    }
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const bool isEncrypted = url.scheme() == QLatin1String("https");
+    const QString host = url.host();
+    const QString path = url.path();
+
+    // Look into the buckets of the host and of each of its parent domains
+    QString domain = host.toLower();
+    while (!domain.isEmpty()) {
+        QHash<QString, QVector<StoredCookie> >::const_iterator bucket = m_cookiesByDomain.constFind(domain);
+        if (bucket != m_cookiesByDomain.constEnd()) {
+            foreach (const StoredCookie& stored, bucket.value()) {
+                const QNetworkCookie& cookie = stored.cookie;
+                if (!isParentDomain(host, cookie.domain()) || !isParentPath(path, cookie.path())) {
+                    continue;
+                }
+                if ((!cookie.isSessionCookie() && cookie.expirationDate() < now) || (cookie.isSecure() && !isEncrypted)) {
+                    continue;
+                }
+                result += cookie;
+            }
+        }
+        const int dot = domain.indexOf(QLatin1Char('.'));
+        domain = dot < 0 ? QString() : domain.mid(dot + 1);
+    }
+
+    // Most specific paths first
+    std::stable_sort(result.begin(), result.end(), hasLongerPath);
+    return result;
+}
+
+// Every change to a single cookie ends up here, to be saved later on
+bool CookieJar::insertCookie(const QNetworkCookie& cookie)
+{
+    // A cookie set with a past date only deletes the one it replaces
+    const bool isDeletion = !cookie.isSessionCookie() && cookie.expirationDate() < QDateTime::currentDateTimeUtc();
+    deleteCookie(cookie);
+    if (isDeletion) {
+        return false;
+    }
+    storeCookie(cookie);
+
+    const QByteArray key = CookieLog::cookieKey(cookie);
+    m_unsavedDeletions.remove(key);
+    m_unsavedCookies.insert(key, cookie);
+    scheduleSave();
+    return true;
+}
+
+bool CookieJar::deleteCookie(const QNetworkCookie& cookie)
+{
+    if (!removeStoredCookie(cookie)) {
+        return false;
+    }
+
+    const QByteArray key = CookieLog::cookieKey(cookie);
+    m_unsavedCookies.remove(key);
+    m_unsavedDeletions.insert(key, cookie);
+    scheduleSave();
+    return true;
 }
 
 bool CookieJar::addCookie(const QNetworkCookie& cookie, const QString& url)
@@ -242,7 +358,8 @@ QList<QNetworkCookie> CookieJar::cookies(const QString& url) const
 {
     if (url.isEmpty()) {
         // No url provided: return all the cookies in this CookieJar
-        return allCookies();
+        const_cast<CookieJar*>(this)->syncWithFile();
+        return storedCookies();
     } else {
         // Return ONLY the cookies that match this URL
         return cookiesForUrl(url);
@@ -311,7 +428,7 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
         // easy to understand. Surely this could be "shrinked", but it
         // would probably look uglier.
 
-        QList<QNetworkCookie> cookiesListAll;
+        QList<QNetworkCookie> cookiesList;
 
         if (url.isEmpty()) {
             if (name.isEmpty()) { //< Neither "name" or "url" provided
@@ -320,12 +437,12 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
                 clearCookies();
             } else { //< Only "name" provided
                 // Delete all cookies with the given name from the CookieJar
-                cookiesListAll = allCookies();
-                for (int i = cookiesListAll.length() - 1; i >= 0; --i) {
-                    if (cookiesListAll.at(i).name() == name) {
+                cookiesList = storedCookies();
+                for (int i = cookiesList.length() - 1; i >= 0; --i) {
+                    if (cookiesList.at(i).name() == name) {
                         // Remove this cookie
-                        qDebug() << "CookieJar - Deleted" << cookiesListAll.at(i).toRawForm();
-                        cookiesListAll.removeAt(i);
+                        qDebug() << "CookieJar - Deleted" << cookiesList.at(i).toRawForm();
+                        deleteCookie(cookiesList.at(i));
                         deleted = true;
                     }
                 }
@@ -333,14 +450,12 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
         } else {
             // Delete cookie(s) from the ones visible to the given "url".
             // Use the "name" to delete only the right one, otherwise all of them.
-            QList<QNetworkCookie> cookiesListUrl = cookies(url);
-            cookiesListAll = allCookies();
-            for (int i = cookiesListAll.length() - 1; i >= 0; --i) {
-                if (cookiesListUrl.contains(cookiesListAll.at(i)) && //< if it part of the set of cookies visible at URL
-                    (cookiesListAll.at(i).name() == name || name.isEmpty())) { //< and if the name matches, or no name provided
+            cookiesList = cookies(url);
+            for (int i = cookiesList.length() - 1; i >= 0; --i) {
+                if (cookiesList.at(i).name() == name || name.isEmpty()) { //< if the name matches, or no name provided
                     // Remove this cookie
-                    qDebug() << "CookieJar - Deleted" << cookiesListAll.at(i).toRawForm();
-                    cookiesListAll.removeAt(i);
+                    qDebug() << "CookieJar - Deleted" << cookiesList.at(i).toRawForm();
+                    deleteCookie(cookiesList.at(i));
                     deleted = true;
 
                     if (!name.isEmpty()) {
@@ -350,9 +465,6 @@ bool CookieJar::deleteCookie(const QString& name, const QString& url)
                 }
             }
         }
-
-        // Put back the remaining cookies
-        setAllCookies(cookiesListAll);
     }
     return deleted;
 }
@@ -376,7 +488,11 @@ bool CookieJar::deleteCookies(const QString& url)
 void CookieJar::clearCookies()
 {
     if (isEnabled()) {
-        setAllCookies(QList<QNetworkCookie>());
+        resetCookies(QList<QNetworkCookie>());
+        m_unsavedCookies.clear();
+        m_unsavedDeletions.clear();
+        m_rewriteNeeded = true;
+        scheduleSave();
     }
 }
 
@@ -403,34 +519,28 @@ void CookieJar::close()
 // private:
 bool CookieJar::purgeExpiredCookies()
 {
-    QList<QNetworkCookie> cookiesList = allCookies();
-
-    // If empty, there is nothing to purge
-    if (cookiesList.isEmpty()) {
-        return false;
-    }
-
-    // Check if any cookie has expired
-    int prePurgeCookiesCount = cookiesList.count();
-    QDateTime now = QDateTime::currentDateTime();
-    for (int i = cookiesList.count() - 1; i >= 0; --i) {
-        if (!cookiesList.at(i).isSessionCookie() && cookiesList.at(i).expirationDate() < now) {
-            qDebug() << "CookieJar - Purged (expired)" << cookiesList.at(i).toRawForm();
-            cookiesList.removeAt(i);
+    // Only the cookies that expired come off the top of the heap
+    bool purged = false;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    while (!m_expiryHeap.isEmpty() && m_expiryHeap.first().time < now) {
+        std::pop_heap(m_expiryHeap.begin(), m_expiryHeap.end());
+        const QNetworkCookie expired = m_expiryHeap.last().cookie;
+        m_expiryHeap.removeLast();
+
+        // Skip the entries of cookies deleted or updated since
+        if (contains(expired) && deleteCookie(expired)) {
+            qDebug() << "CookieJar - Purged (expired)" << expired.toRawForm();
+            purged = true;
         }
     }
 
-    // Set cookies and returns "true" if at least 1 cookie expired and has been removed
-    if (prePurgeCookiesCount != cookiesList.count()) {
-        setAllCookies(cookiesList);
-        return true;
-    }
-    return false;
+    // Returns "true" if at least 1 cookie expired and has been removed
+    return purged;
 }
 
 bool CookieJar::purgeSessionCookies()
 {
-    QList<QNetworkCookie> cookiesList = allCookies();
+    QList<QNetworkCookie> cookiesList = storedCookies();
 
     // If empty, there is nothing to purge
     if (cookiesList.isEmpty()) {
@@ -438,73 +548,256 @@ bool CookieJar::purgeSessionCookies()
     }
 
     // Check if any cookie has expired
-    int prePurgeCookiesCount = cookiesList.count();
+    bool purged = false;
     for (int i = cookiesList.count() - 1; i >= 0; --i) {
         if (cookiesList.at(i).isSessionCookie()) {
             qDebug() << "CookieJar - Purged (session)" << cookiesList.at(i).toRawForm();
-            cookiesList.removeAt(i);
+            deleteCookie(cookiesList.at(i));
+            purged = true;
         }
     }
 
-    // Set cookies and returns "true" if at least 1 session cookie was found and removed
-    if (prePurgeCookiesCount != cookiesList.count()) {
-        setAllCookies(cookiesList);
-        return true;
-    }
-    return false;
+    // Returns "true" if at least 1 session cookie was found and removed
+    return purged;
 }
 
 void CookieJar::save()
 {
-    if (isEnabled()) {
+    m_saveTimer.stop();
+
+    if (isEnabled() && m_cookieLog) {
+        // Another process is holding the file: keep the changes for the next try
+        if (!m_cookieLog->lock()) {
+            qDebug() << "CookieJar - Could not lock" << m_cookieLog->fileName() << "to save, will retry";
+            m_saveTimer.start();
+            return;
+        }
+
+        // Other processes may have written since: build on their changes,
+        // unless ours replace everything anyway
+        if (!m_rewriteNeeded) {
+            m_lastSync.invalidate();
+            syncWithFile();
+        }
+
         // Get rid of all the Cookies that have expired
         purgeExpiredCookies();
 
 #ifndef QT_NO_DEBUG_OUTPUT
-        foreach (QNetworkCookie cookie, allCookies()) {
+        foreach (QNetworkCookie cookie, m_unsavedCookies) {
             qDebug() << "CookieJar - Saved" << cookie.toRawForm();
         }
 #endif
 
-        // Store cookies
-        if (m_cookieStorage) {
-            m_cookieStorage->setValue(QLatin1String("cookies"), QVariant::fromValue<QList<QNetworkCookie>>(allCookies()));
+        // Store the changes, or all the cookies once the log is mostly obsolete records
+        bool saved;
+        if (m_rewriteNeeded || m_cookieLog->needsCompaction(m_cookieCount)) {
+            saved = m_cookieLog->rewrite(storedCookies());
+        } else {
+            saved = m_cookieLog->append(m_unsavedCookies.values(), m_unsavedDeletions.values());
+        }
+        m_cookieLog->unlock();
+
+        if (!saved) {
+            m_saveTimer.start();
+            return;
         }
     }
+
+    m_unsavedCookies.clear();
+    m_unsavedDeletions.clear();
+    m_rewriteNeeded = false;
 }
 
 void CookieJar::load()
 {
     if (isEnabled()) {
-        // Register a "StreamOperator" for this Meta Type, so we can easily serialize/deserialize the cookies
-        qRegisterMetaTypeStreamOperators<QList<QNetworkCookie>>("QList<QNetworkCookie>");
+        QList<QNetworkCookie> cookiesList;
 
         // Load all the cookies
-        if (m_cookieStorage) {
-            setAllCookies(qvariant_cast<QList<QNetworkCookie>>(m_cookieStorage->value(QLatin1String("cookies"))));
+        if (m_cookieLog) {
+            const QString cookiesFile = m_cookieLog->fileName();
+            if (QFile::exists(cookiesFile) && !CookieLog::isCookieLog(cookiesFile)) {
+                // Written by an earlier version: convert it
+                cookiesList = loadSettingsFile(cookiesFile);
+                m_rewriteNeeded = true;
+            } else {
+                m_cookieLog->read(&cookiesList);
+                m_rewriteNeeded = m_cookieLog->needsCompaction(cookiesList.size());
+            }
         }
+        resetCookies(cookiesList);
 
         // If any cookie has expired since last execution, purge and save before going any further
-        if (purgeExpiredCookies()) {
+        if (purgeExpiredCookies() || m_rewriteNeeded) {
             save();
         }
 
 #ifndef QT_NO_DEBUG_OUTPUT
-        foreach (QNetworkCookie cookie, allCookies()) {
+        foreach (QNetworkCookie cookie, storedCookies()) {
             qDebug() << "CookieJar - Loaded" << cookie.toRawForm();
         }
 #endif
     }
 }
 
+QList<QNetworkCookie> CookieJar::loadSettingsFile(const QString& cookiesFile) const
+{
+    // Register a "StreamOperator" for this Meta Type, so we can easily deserialize the cookies
+    qRegisterMetaTypeStreamOperators<QList<QNetworkCookie>>("QList<QNetworkCookie>");
+
+    QSettings settings(cookiesFile, QSettings::IniFormat);
+    return qvariant_cast<QList<QNetworkCookie>>(settings.value(QLatin1String("cookies")));
+}
+
+void CookieJar::scheduleSave()
+{
+    if (m_cookieLog && !m_saveTimer.isActive()) {
+        m_saveTimer.start();
+    }
+}
+
+void CookieJar::syncWithFile()
+{
+    if (!m_cookieLog || m_rewriteNeeded) {
+        return;
+    }
+    if (m_lastSync.isValid() && m_lastSync.elapsed() < COOKIE_JAR_SYNC_INTERVAL) {
+        return;
+    }
+    m_lastSync.start();
+    if (!m_cookieLog->hasChanged()) {
+        return;
+    }
+
+    QList<CookieLog::Change> changes;
+    if (!m_cookieLog->readChanges(&changes)) {
+        // Rewritten by another process: start over from its content,
+        // then redo the changes of ours it does not have yet
+        QList<QNetworkCookie> cookiesList;
+        m_cookieLog->read(&cookiesList);
+        resetCookies(cookiesList);
+        foreach (const QNetworkCookie& cookie, m_unsavedDeletions) {
+            removeStoredCookie(cookie);
+        }
+        foreach (const QNetworkCookie& cookie, m_unsavedCookies) {
+            removeStoredCookie(cookie);
+            storeCookie(cookie);
+        }
+        return;
+    }
+
+    foreach (const CookieLog::Change& change, changes) {
+        // Our own changes, not written yet, are more recent
+        const QByteArray key = CookieLog::cookieKey(change.cookie);
+        if (m_unsavedCookies.contains(key) || m_unsavedDeletions.contains(key)) {
+            continue;
+        }
+        removeStoredCookie(change.cookie);
+        if (!change.removed) {
+            storeCookie(change.cookie);
+        }
+    }
+}
+
 bool CookieJar::contains(const QNetworkCookie& cookieToFind) const
 {
-    QList<QNetworkCookie> cookiesList = allCookies();
-    foreach (QNetworkCookie cookie, cookiesList) {
-        if (cookieToFind == cookie) {
-            return true;
+    QHash<QString, QVector<StoredCookie> >::const_iterator bucket = m_cookiesByDomain.constFind(domainKey(cookieToFind.domain()));
+    if (bucket != m_cookiesByDomain.constEnd()) {
+        foreach (const StoredCookie& stored, bucket.value()) {
+            if (stored.cookie == cookieToFind) {
+                return true;
+            }
         }
     }
 
     return false;
 }
+
+QList<QNetworkCookie> CookieJar::storedCookies() const
+{
+    QVector<StoredCookie> all;
+    all.reserve(m_cookieCount);
+    foreach (const QVector<StoredCookie>& bucket, m_cookiesByDomain) {
+        all += bucket;
+    }
+    std::sort(all.begin(), all.end());
+
+    QList<QNetworkCookie> cookiesList;
+    cookiesList.reserve(all.size());
+    foreach (const StoredCookie& stored, all) {
+        cookiesList += stored.cookie;
+    }
+    return cookiesList;
+}
+
+void CookieJar::storeCookie(const QNetworkCookie& cookie)
+{
+    StoredCookie stored;
+    stored.cookie = cookie;
+    stored.sequence = m_nextSequence++;
+    m_cookiesByDomain[domainKey(cookie.domain())] += stored;
+    ++m_cookieCount;
+
+    if (!cookie.isSessionCookie()) {
+        Expiry expiry;
+        expiry.time = cookie.expirationDate().toMSecsSinceEpoch();
+        expiry.cookie = cookie;
+        m_expiryHeap += expiry;
+        std::push_heap(m_expiryHeap.begin(), m_expiryHeap.end());
+
+        // Updated cookies leave entries behind: drop them once they dominate
+        if (m_expiryHeap.size() > 2 * m_cookieCount + 64) {
+            rebuildExpiryHeap();
+        }
+    }
+}
+
+bool CookieJar::removeStoredCookie(const QNetworkCookie& cookie)
+{
+    QHash<QString, QVector<StoredCookie> >::iterator bucket = m_cookiesByDomain.find(domainKey(cookie.domain()));
+    if (bucket == m_cookiesByDomain.end()) {
+        return false;
+    }
+
+    QVector<StoredCookie>& stored = bucket.value();
+    int i = 0;
+    while (i < stored.size() && !stored.at(i).cookie.hasSameIdentifier(cookie)) {
+        ++i;
+    }
+    if (i == stored.size()) {
+        return false;
+    }
+    stored.remove(i);
+    if (stored.isEmpty()) {
+        m_cookiesByDomain.erase(bucket);
+    }
+    --m_cookieCount;
+    return true;
+}
+
+void CookieJar::resetCookies(const QList<QNetworkCookie>& cookies)
+{
+    m_cookiesByDomain.clear();
+    m_cookieCount = 0;
+    m_expiryHeap.clear();
+    foreach (const QNetworkCookie& cookie, cookies) {
+        storeCookie(cookie);
+    }
+}
+
+void CookieJar::rebuildExpiryHeap()
+{
+    m_expiryHeap.clear();
+    foreach (const QVector<StoredCookie>& bucket, m_cookiesByDomain) {
+        foreach (const StoredCookie& stored, bucket) {
+            if (!stored.cookie.isSessionCookie()) {
+                Expiry expiry;
+                expiry.time = stored.cookie.expirationDate().toMSecsSinceEpoch();
+                expiry.cookie = stored.cookie;
+                m_expiryHeap += expiry;
+            }
+        }
+    }
+    std::make_heap(m_expiryHeap.begin(), m_expiryHeap.end());
+}
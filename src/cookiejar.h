@@ -31,11 +31,16 @@
 #ifndef COOKIEJAR_H
 #define COOKIEJAR_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QNetworkCookie>
 #include <QNetworkCookieJar>
-#include <QSettings>
+#include <QTimer>
 #include <QVariantList>
 #include <QVariantMap>
+#include <QVector>
+
+class CookieLog;
 
 class CookieJar : public QNetworkCookieJar {
     Q_OBJECT
@@ -56,7 +61,8 @@ public:
 
     QNetworkCookie cookie(const QString& name, const QString& url = QString()) const;
 
-    using QNetworkCookieJar::deleteCookie;
+    bool insertCookie(const QNetworkCookie& cookie);
+    bool deleteCookie(const QNetworkCookie& cookie);
     bool deleteCookies(const QString& url = QString());
 
     void enable();
@@ -80,10 +86,50 @@ private slots:
     void load();
 
 private:
+    struct StoredCookie {
+        QNetworkCookie cookie;
+        // Order in which the cookies were set, kept when listing all of them
+        quint64 sequence;
+        bool operator<(const StoredCookie& other) const { return sequence < other.sequence; }
+    };
+
+    struct Expiry {
+        qint64 time;
+        QNetworkCookie cookie;
+        // Min-heap ordering for std::push_heap and friends
+        bool operator<(const Expiry& other) const { return time > other.time; }
+    };
+
     bool contains(const QNetworkCookie& cookie) const;
+    void scheduleSave();
+    void syncWithFile();
+    QList<QNetworkCookie> loadSettingsFile(const QString& cookiesFile) const;
+
+    QList<QNetworkCookie> storedCookies() const;
+    void storeCookie(const QNetworkCookie& cookie);
+    bool removeStoredCookie(const QNetworkCookie& cookie);
+    void resetCookies(const QList<QNetworkCookie>& cookies);
+    void rebuildExpiryHeap();
 
 private:
-    QSettings* m_cookieStorage;
+    // The cookies, by domain without its leading dot: a URL only needs the
+    // buckets of its host and of the host's parent domains
+    QHash<QString, QVector<StoredCookie> > m_cookiesByDomain;
+    int m_cookieCount;
+    quint64 m_nextSequence;
+    // Cookies by expiration date, soonest first; entries of cookies that
+    // were deleted or updated since are skipped when they come out
+    QVector<Expiry> m_expiryHeap;
+
+    CookieLog* m_cookieLog;
+    // Changes not written yet, by cookie identifier
+    QHash<QByteArray, QNetworkCookie> m_unsavedCookies;
+    QHash<QByteArray, QNetworkCookie> m_unsavedDeletions;
+    // Set when the changes are not known one by one
+    bool m_rewriteNeeded;
+    QTimer m_saveTimer;
+    // Since the records other processes appended to the file were last looked for
+    mutable QElapsedTimer m_lastSync;
     bool m_enabled;
 };
 
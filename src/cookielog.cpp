@@ -0,0 +1,330 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "cookielog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QUuid>
+
+static const QByteArray COOKIE_LOG_HEADER("# PhantomJS cookie log 1\n");
+
+// Below this, compacting is not worth the rewrite whatever the ratio
+static const int COOKIE_LOG_MIN_COMPACTION_RECORDS = 256;
+
+// How long a writer waits for another one, in milliseconds
+static const int COOKIE_LOG_LOCK_TIMEOUT = 5000;
+
+static QByteArray record(char change, const QNetworkCookie& cookie)
+{
+    return change + cookie.toRawForm(QNetworkCookie::Full) + '\n';
+}
+
+static QByteArray newGeneration()
+{
+    return '#' + QUuid::createUuid().toByteArray() + '\n';
+}
+
+CookieLog::CookieLog(const QString& fileName)
+    : m_fileName(fileName)
+    , m_offset(0)
+    , m_size(-1)
+    , m_lastModified(-1)
+    , m_recordCount(0)
+    , m_writeLock(fileName + ".lock")
+    , m_userLock(Q_NULLPTR)
+{
+    // Only a dead writer leaves a stale lock, which its PID tells
+    m_writeLock.setStaleLockTime(0);
+}
+
+CookieLog::~CookieLog()
+{
+    delete m_userLock;
+}
+
+QString CookieLog::fileName() const
+{
+    return m_fileName;
+}
+
+bool CookieLog::read(QList<QNetworkCookie>* cookies)
+{
+    cookies->clear();
+    m_generation.clear();
+    m_offset = 0;
+    m_recordCount = 0;
+
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly) || file.readLine() != COOKIE_LOG_HEADER) {
+        return false;
+    }
+    m_offset = file.pos();
+    m_generation = file.readLine();
+    if (m_generation.startsWith('#')) {
+        m_offset = file.pos();
+    } else {
+        // Written before generations: compaction gives it one
+        m_generation.clear();
+        file.seek(m_offset);
+    }
+
+    QList<Change> changes;
+    readRecords(&file, &changes);
+
+    QHash<QByteArray, QNetworkCookie> live;
+    QList<QByteArray> order;
+    foreach (const Change& change, changes) {
+        const QByteArray key = cookieKey(change.cookie);
+        if (change.removed) {
+            live.remove(key);
+        } else {
+            if (!live.contains(key)) {
+                order += key;
+            }
+            live.insert(key, change.cookie);
+        }
+    }
+
+    foreach (const QByteArray& key, order) {
+        QHash<QByteArray, QNetworkCookie>::const_iterator it = live.constFind(key);
+        if (it != live.constEnd()) {
+            cookies->append(it.value());
+        }
+    }
+    return true;
+}
+
+bool CookieLog::readChanges(QList<Change>* changes)
+{
+    changes->clear();
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        // Nothing written yet, or removed from under us
+        return m_generation.isEmpty();
+    }
+    if (file.readLine() != COOKIE_LOG_HEADER || file.readLine() != m_generation) {
+        return false;
+    }
+
+    file.seek(m_offset);
+    readRecords(&file, changes);
+    return true;
+}
+
+bool CookieLog::hasChanged() const
+{
+    QFileInfo info(m_fileName);
+    return info.size() != m_size || info.lastModified().toMSecsSinceEpoch() != m_lastModified;
+}
+
+bool CookieLog::append(const QList<QNetworkCookie>& added, const QList<QNetworkCookie>& removed)
+{
+    if (added.isEmpty() && removed.isEmpty()) {
+        return true;
+    }
+
+    QByteArray records;
+    foreach (const QNetworkCookie& cookie, removed) {
+        records += record('-', cookie);
+    }
+    foreach (const QNetworkCookie& cookie, added) {
+        records += record('+', cookie);
+    }
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "CookieLog - Unable to open" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+    if (file.size() == 0) {
+        m_generation = newGeneration();
+        records.prepend(COOKIE_LOG_HEADER + m_generation);
+    }
+    // A single write, so that a crash leaves at most one record cut short
+    // and readers never see a record in part
+    if (file.write(records) != records.size()) {
+        qWarning() << "CookieLog - Unable to write to" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+    file.close();
+
+    m_recordCount += added.size() + removed.size();
+    // Valid as writers read the records of the others first, under the lock
+    QFileInfo info(m_fileName);
+    m_offset = m_size = info.size();
+    m_lastModified = info.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+bool CookieLog::rewrite(const QList<QNetworkCookie>& cookies)
+{
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "CookieLog - Unable to open" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    const QByteArray generation = newGeneration();
+    QByteArray content(COOKIE_LOG_HEADER + generation);
+    foreach (const QNetworkCookie& cookie, cookies) {
+        content += record('+', cookie);
+    }
+    file.write(content);
+    if (!file.commit()) {
+        qWarning() << "CookieLog - Unable to write to" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    m_generation = generation;
+    m_recordCount = cookies.size();
+    QFileInfo info(m_fileName);
+    m_offset = m_size = info.size();
+    m_lastModified = info.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+bool CookieLog::needsCompaction(int liveCount) const
+{
+    if (m_generation.isEmpty()) {
+        return m_recordCount > 0;
+    }
+    return m_recordCount > COOKIE_LOG_MIN_COMPACTION_RECORDS && m_recordCount > 2 * liveCount;
+}
+
+bool CookieLog::lock()
+{
+    if (!m_writeLock.tryLock(COOKIE_LOG_LOCK_TIMEOUT)) {
+        qWarning() << "CookieLog - Unable to lock" << m_fileName << ":" << m_writeLock.error();
+        return false;
+    }
+    return true;
+}
+
+void CookieLog::unlock()
+{
+    m_writeLock.unlock();
+}
+
+void CookieLog::addUser()
+{
+    if (m_userLock) {
+        return;
+    }
+
+    QDir().mkpath(usersPath());
+    m_userLock = new QLockFile(usersPath() + "/" + QUuid::createUuid().toString() + ".lock");
+    m_userLock->setStaleLockTime(0);
+    if (!m_userLock->tryLock(0)) {
+        // The last user of the file may have just removed the directory
+        QDir().mkpath(usersPath());
+        m_userLock->tryLock(0);
+    }
+}
+
+bool CookieLog::releaseUser()
+{
+    delete m_userLock;
+    m_userLock = Q_NULLPTR;
+
+    // The lock files of live processes can not be taken; the others are stale
+    QDir users(usersPath());
+    foreach (const QString& entry, users.entryList(QStringList("*.lock"), QDir::Files)) {
+        QLockFile other(users.filePath(entry));
+        other.setStaleLockTime(0);
+        if (!other.tryLock(0)) {
+            return false;
+        }
+        other.unlock();
+    }
+    users.rmdir(users.absolutePath());
+    return true;
+}
+
+QByteArray CookieLog::cookieKey(const QNetworkCookie& cookie)
+{
+    return cookie.name() + '\t' + cookie.domain().toUtf8() + '\t' + cookie.path().toUtf8();
+}
+
+bool CookieLog::isCookieLog(const QString& fileName)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::ReadOnly) && file.readLine() == COOKIE_LOG_HEADER;
+}
+
+// private:
+
+bool CookieLog::readRecords(QIODevice* file, QList<Change>* changes)
+{
+    while (!file->atEnd()) {
+        QByteArray line = file->readLine();
+        // Cut short by a crash, or still being written by another process:
+        // leave it for the next read
+        if (!line.endsWith('\n')) {
+            break;
+        }
+        m_offset = file->pos();
+
+        line.chop(1);
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QList<QNetworkCookie> parsed = QNetworkCookie::parseCookies(line.mid(1));
+        if (parsed.isEmpty()) {
+            qWarning() << "CookieLog - Unable to parse record:" << line;
+            continue;
+        }
+        ++m_recordCount;
+
+        Change change;
+        change.removed = line.at(0) == '-';
+        change.cookie = parsed.first();
+        changes->append(change);
+    }
+
+    QFileInfo info(m_fileName);
+    m_size = info.size();
+    m_lastModified = info.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+QString CookieLog::usersPath() const
+{
+    return m_fileName + ".users";
+}
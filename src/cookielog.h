@@ -0,0 +1,137 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef COOKIELOG_H
+#define COOKIELOG_H
+
+#include <QList>
+#include <QLockFile>
+#include <QNetworkCookie>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * Persistent cookie storage as a log: changes are appended to the file
+ * as they happen and the whole file is only rewritten, with the cookies
+ * still alive, once the obsolete records outweigh them.
+ *
+ * The file is made of text lines: a header, a generation line, then one
+ * record per change, "+" followed by the raw form of a cookie set or "-"
+ * followed by the raw form of a cookie removed. Replaying the records in
+ * order gives the current cookies.
+ *
+ * Several processes can share the file: writers take a lock file next to
+ * it, and readers pick up the records appended by others since their last
+ * read. A rewrite replaces the file atomically under a new generation,
+ * which tells the others to read it again from the start.
+ */
+class CookieLog {
+public:
+    struct Change {
+        bool removed;
+        QNetworkCookie cookie;
+    };
+
+    explicit CookieLog(const QString& fileName);
+    ~CookieLog();
+
+    QString fileName() const;
+
+    /**
+     * Replay the whole file.
+     * @param cookies receives the cookies the file ends up with
+     * @return false if the file exists but is not a cookie log
+     */
+    bool read(QList<QNetworkCookie>* cookies);
+
+    /**
+     * Read the records appended since the last read or write.
+     * @param changes receives the records, in order
+     * @return false if the file was rewritten meanwhile and must be read again
+     */
+    bool readChanges(QList<Change>* changes);
+
+    /**
+     * Whether the file may hold records this log did not read yet.
+     * Only looks at the file's size and date.
+     */
+    bool hasChanged() const;
+
+    bool append(const QList<QNetworkCookie>& added, const QList<QNetworkCookie>& removed);
+
+    /**
+     * Replace the file, atomically, with one holding only these cookies.
+     */
+    bool rewrite(const QList<QNetworkCookie>& cookies);
+
+    /**
+     * Whether enough records are obsolete for a rewrite to pay off.
+     * @param liveCount the number of cookies the log holds
+     */
+    bool needsCompaction(int liveCount) const;
+
+    /**
+     * Writers hold this lock, so that their records and rewrites do not mix.
+     */
+    bool lock();
+    void unlock();
+
+    /**
+     * Record this process as one of the users of the file, until releaseUser().
+     */
+    void addUser();
+
+    /**
+     * @return whether no other live process uses the file any more
+     */
+    bool releaseUser();
+
+    static bool isCookieLog(const QString& fileName);
+
+    // Cookies are identified by name, domain and path, as in QNetworkCookie::hasSameIdentifier
+    static QByteArray cookieKey(const QNetworkCookie& cookie);
+
+private:
+    bool readRecords(QIODevice* file, QList<Change>* changes);
+    QString usersPath() const;
+
+    QString m_fileName;
+    QByteArray m_generation;
+    // Where the records not read yet start
+    qint64 m_offset;
+    qint64 m_size;
+    qint64 m_lastModified;
+    int m_recordCount;
+    QLockFile m_writeLock;
+    QLockFile* m_userLock;
+};
+
+#endif // COOKIELOG_H
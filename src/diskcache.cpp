@@ -0,0 +1,421 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "diskcache.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+
+#include <algorithm>
+
+#define DISK_CACHE_MAGIC 0x7068436b
+#define DISK_CACHE_VERSION 1
+
+// Default maximum size, as QNetworkDiskCache's
+#define DISK_CACHE_DEFAULT_SIZE (50 * 1024 * 1024)
+
+// A blob no entry uses is left alone this long, in milliseconds, as
+// the entry of another process may be on its way
+#define DISK_CACHE_GRACE_PERIOD (60 * 1000)
+
+static struct {
+    qint64 hits;
+    qint64 misses;
+    qint64 bytesSaved;
+    qint64 blobsWritten;
+} diskCacheStats = { 0, 0, 0, 0 };
+
+static QByteArray sha1(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+// Spread the files over 256 directories, by the first two digits of their name
+static QString fanOut(const QString& directory, const QByteArray& name)
+{
+    return directory + "/" + QString::fromLatin1(name.left(2)) + "/" + QString::fromLatin1(name);
+}
+
+static bool isHash(const QString& name)
+{
+    static const QRegExp pattern("[0-9a-f]{40}");
+    return pattern.exactMatch(name);
+}
+
+static bool commit(const QString& path, const QByteArray& content)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit()) {
+        qWarning() << "DiskCache - Unable to write" << path << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+// Marks a file of this size as just used. Writing its first byte again does
+// it with any Qt version; false if the file is not there, or not as expected.
+static bool touch(const QString& path, qint64 size)
+{
+    QFile file(path);
+    if (!QFile::exists(path) || !file.open(QIODevice::ReadWrite) || file.size() != size) {
+        return false;
+    }
+    const QByteArray first = file.read(1);
+    return first.size() == 1 && file.seek(0) && file.write(first) == 1;
+}
+
+// public:
+DiskCache::DiskCache(const QString& cacheDirectory, QObject* parent)
+    : QAbstractNetworkCache(parent)
+    , m_directory(QDir(cacheDirectory).absolutePath())
+    , m_maximumSize(DISK_CACHE_DEFAULT_SIZE)
+    , m_size(0)
+    , m_trimLock(m_directory + "/trim.lock")
+{
+    // Only a process that died trimming leaves a stale lock, which its PID tells
+    m_trimLock.setStaleLockTime(0);
+    QDir().mkpath(m_directory);
+    readSummary();
+}
+
+DiskCache::~DiskCache()
+{
+    qDeleteAll(m_inserting.keys());
+}
+
+QString DiskCache::cacheDirectory() const
+{
+    return m_directory;
+}
+
+qint64 DiskCache::maximumCacheSize() const
+{
+    return m_maximumSize;
+}
+
+void DiskCache::setMaximumCacheSize(qint64 size)
+{
+    m_maximumSize = size;
+    if (m_size > m_maximumSize) {
+        trim();
+    }
+}
+
+QNetworkCacheMetaData DiskCache::metaData(const QUrl& url)
+{
+    Entry entry;
+    if (!readEntry(entryPath(url), &entry)) {
+        ++diskCacheStats.misses;
+        return QNetworkCacheMetaData();
+    }
+    return entry.metaData;
+}
+
+void DiskCache::updateMetaData(const QNetworkCacheMetaData& metaData)
+{
+    Entry entry;
+    if (readEntry(entryPath(metaData.url()), &entry)) {
+        entry.metaData = metaData;
+        writeEntry(entry);
+    }
+}
+
+QIODevice* DiskCache::data(const QUrl& url)
+{
+    Entry entry;
+    const QString path = entryPath(url);
+    if (!readEntry(path, &entry)) {
+        return Q_NULLPTR;
+    }
+
+    QFile* file = new QFile(blobPath(entry.blob));
+    if (!file->open(QIODevice::ReadOnly)) {
+        // Its blob was trimmed away by another process
+        delete file;
+        QFile::remove(path);
+        ++diskCacheStats.misses;
+        return Q_NULLPTR;
+    }
+
+    ++diskCacheStats.hits;
+    diskCacheStats.bytesSaved += entry.size;
+    return file;
+}
+
+bool DiskCache::remove(const QUrl& url)
+{
+    // Drop whatever is being stored for it too
+    QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = m_inserting.begin();
+    while (it != m_inserting.end()) {
+        if (it.value().url() == url) {
+            delete it.key();
+            it = m_inserting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // The blob goes with the next trim, if no other entry uses it
+    return QFile::remove(entryPath(url));
+}
+
+qint64 DiskCache::cacheSize() const
+{
+    return m_size;
+}
+
+QIODevice* DiskCache::prepare(const QNetworkCacheMetaData& metaData)
+{
+    if (!metaData.isValid() || !metaData.url().isValid() || !metaData.saveToDisk()) {
+        return Q_NULLPTR;
+    }
+
+    // Like QNetworkDiskCache, leave out what would take most of the cache
+    foreach (const QNetworkCacheMetaData::RawHeader& header, metaData.rawHeaders()) {
+        if (header.first.toLower() == "content-length" && header.second.toLongLong() > m_maximumSize * 3 / 4) {
+            return Q_NULLPTR;
+        }
+    }
+
+    QBuffer* buffer = new QBuffer;
+    buffer->open(QIODevice::ReadWrite);
+    m_inserting.insert(buffer, metaData);
+    return buffer;
+}
+
+void DiskCache::insert(QIODevice* device)
+{
+    QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = m_inserting.find(device);
+    if (it == m_inserting.end()) {
+        return;
+    }
+
+    Entry entry;
+    entry.metaData = it.value();
+    m_inserting.erase(it);
+    const QByteArray content = static_cast<QBuffer*>(device)->data();
+    delete device;
+
+    entry.size = content.size();
+    if (writeBlob(content, &entry.blob)) {
+        writeEntry(entry);
+    }
+
+    if (m_size > m_maximumSize) {
+        trim();
+    }
+}
+
+QVariantMap DiskCache::stats()
+{
+    QVariantMap result;
+    result["hits"] = diskCacheStats.hits;
+    result["misses"] = diskCacheStats.misses;
+    result["bytesSaved"] = diskCacheStats.bytesSaved;
+    result["blobsWritten"] = diskCacheStats.blobsWritten;
+    return result;
+}
+
+void DiskCache::clear()
+{
+    qDeleteAll(m_inserting.keys());
+    m_inserting.clear();
+
+    // Entries first, so that no entry is left without its blob
+    QDir(m_directory + "/entries").removeRecursively();
+    QDir(m_directory + "/blobs").removeRecursively();
+    m_size = 0;
+    writeSummary();
+}
+
+// private:
+bool DiskCache::readEntry(const QString& path, Entry* entry) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if (magic != DISK_CACHE_MAGIC || version != DISK_CACHE_VERSION) {
+        return false;
+    }
+    in >> entry->metaData >> entry->blob >> entry->size;
+    return in.status() == QDataStream::Ok && isHash(QString::fromLatin1(entry->blob));
+}
+
+bool DiskCache::writeEntry(const Entry& entry)
+{
+    QByteArray content;
+    QDataStream out(&content, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(DISK_CACHE_MAGIC) << qint32(DISK_CACHE_VERSION);
+    out << entry.metaData << entry.blob << entry.size;
+    return commit(entryPath(entry.metaData.url()), content);
+}
+
+QString DiskCache::entryPath(const QUrl& url) const
+{
+    const QUrl key = url.adjusted(QUrl::RemoveFragment | QUrl::RemovePassword);
+    return fanOut(m_directory + "/entries", sha1(key.toEncoded()));
+}
+
+QString DiskCache::blobPath(const QByteArray& blob) const
+{
+    return fanOut(m_directory + "/blobs", blob);
+}
+
+bool DiskCache::writeBlob(const QByteArray& content, QByteArray* blob)
+{
+    *blob = sha1(content);
+    const QString path = blobPath(*blob);
+    // Touched, so that trim() in another process does not take it for unused
+    // before the entry pointing to it is written
+    if (!content.isEmpty() && touch(path, content.size())) {
+        diskCacheStats.bytesSaved += content.size();
+        return true;
+    }
+    if (!commit(path, content)) {
+        return false;
+    }
+
+    ++diskCacheStats.blobsWritten;
+    m_size += content.size();
+    return true;
+}
+
+void DiskCache::readSummary()
+{
+    QFile file(m_directory + "/summary");
+    if (file.open(QIODevice::ReadOnly)) {
+        m_size = file.readAll().trimmed().toLongLong();
+    } else if (QDir(m_directory + "/blobs").exists()) {
+        // Written to, but never trimmed yet: find out
+        trim();
+    }
+}
+
+void DiskCache::writeSummary()
+{
+    commit(m_directory + "/summary", QByteArray::number(m_size) + '\n');
+}
+
+void DiskCache::trim()
+{
+    // Another process is at it
+    if (!m_trimLock.tryLock(0)) {
+        return;
+    }
+
+    struct Blob {
+        qint64 size;
+        QDateTime modified;
+        int users;
+    };
+    QHash<QByteArray, Blob> blobs;
+    qint64 total = 0;
+    QDirIterator blobFiles(m_directory + "/blobs", QDir::Files, QDirIterator::Subdirectories);
+    while (blobFiles.hasNext()) {
+        blobFiles.next();
+        const QFileInfo info = blobFiles.fileInfo();
+        // Leaves out the temporary files of writes in progress
+        if (isHash(info.fileName())) {
+            Blob blob = { info.size(), info.lastModified(), 0 };
+            blobs.insert(info.fileName().toLatin1(), blob);
+            total += info.size();
+        }
+    }
+
+    struct Stored {
+        QString path;
+        QByteArray blob;
+        QDateTime modified;
+        bool operator<(const Stored& other) const { return modified < other.modified; }
+    };
+    QVector<Stored> entries;
+    QDirIterator entryFiles(m_directory + "/entries", QDir::Files, QDirIterator::Subdirectories);
+    while (entryFiles.hasNext()) {
+        const QString path = entryFiles.next();
+        Entry entry;
+        if (!isHash(entryFiles.fileName()) || !readEntry(path, &entry)) {
+            continue;
+        }
+        QHash<QByteArray, Blob>::iterator blob = blobs.find(entry.blob);
+        if (blob == blobs.end()) {
+            QFile::remove(path);
+            continue;
+        }
+        ++blob.value().users;
+        Stored stored = { path, entry.blob, entryFiles.fileInfo().lastModified() };
+        entries += stored;
+    }
+
+    // Blobs no entry uses any more
+    const QDateTime graceLimit = QDateTime::currentDateTimeUtc().addMSecs(-DISK_CACHE_GRACE_PERIOD);
+    for (QHash<QByteArray, Blob>::const_iterator it = blobs.constBegin(); it != blobs.constEnd(); ++it) {
+        if (it.value().users == 0 && it.value().modified < graceLimit && QFile::remove(blobPath(it.key()))) {
+            total -= it.value().size;
+        }
+    }
+
+    // Then the oldest entries, down to 90% of the maximum so as not to trim again right away
+    if (total > m_maximumSize) {
+        const qint64 goal = m_maximumSize * 9 / 10;
+        std::sort(entries.begin(), entries.end());
+        foreach (const Stored& stored, entries) {
+            if (total <= goal) {
+                break;
+            }
+            QFile::remove(stored.path);
+            Blob& blob = blobs[stored.blob];
+            if (--blob.users == 0 && QFile::remove(blobPath(stored.blob))) {
+                total -= blob.size;
+            }
+        }
+    }
+
+    m_size = total;
+    writeSummary();
+    m_trimLock.unlock();
+}
@@ -0,0 +1,110 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <QAbstractNetworkCache>
+#include <QHash>
+#include <QLockFile>
+#include <QVariantMap>
+
+/**
+ * Disk cache that concurrent processes can share, storing each distinct
+ * body once.
+ *
+ * Bodies are blobs named by the SHA-1 of their content, under "blobs/";
+ * the same script served from many URLs takes the space of one. Each URL
+ * has an entry file under "entries/", named by the SHA-1 of the URL, with
+ * its metadata and the name of its blob: finding a URL opens one file,
+ * and nothing needs loading at startup but a small summary of the size.
+ *
+ * Blobs and entries are only ever written whole to a temporary file then
+ * renamed into place, so readers in other processes see either the old or
+ * the new version. Going over the maximum size, one process at a time,
+ * under a lock file, drops the oldest entries and the blobs no entry uses
+ * any more.
+ */
+class DiskCache : public QAbstractNetworkCache {
+    Q_OBJECT
+
+public:
+    DiskCache(const QString& cacheDirectory, QObject* parent = Q_NULLPTR);
+    virtual ~DiskCache();
+
+    QString cacheDirectory() const;
+
+    qint64 maximumCacheSize() const;
+    void setMaximumCacheSize(qint64 size);
+
+    QNetworkCacheMetaData metaData(const QUrl& url);
+    void updateMetaData(const QNetworkCacheMetaData& metaData);
+    QIODevice* data(const QUrl& url);
+    bool remove(const QUrl& url);
+    qint64 cacheSize() const;
+
+    QIODevice* prepare(const QNetworkCacheMetaData& metaData);
+    void insert(QIODevice* device);
+
+    /**
+     * Counters for all the disk caches of this process: "hits", "misses",
+     * "bytesSaved" (served from the cache, or not written as already there)
+     * and "blobsWritten".
+     */
+    static QVariantMap stats();
+
+public slots:
+    void clear();
+
+private:
+    struct Entry {
+        QNetworkCacheMetaData metaData;
+        QByteArray blob;
+        qint64 size;
+    };
+
+    bool readEntry(const QString& path, Entry* entry) const;
+    bool writeEntry(const Entry& entry);
+    QString entryPath(const QUrl& url) const;
+    QString blobPath(const QByteArray& blob) const;
+    bool writeBlob(const QByteArray& content, QByteArray* blob);
+    void readSummary();
+    void writeSummary();
+    void trim();
+
+    QString m_directory;
+    qint64 m_maximumSize;
+    // Estimated, as other processes write too: set right by each trim
+    qint64 m_size;
+    QHash<QIODevice*, QNetworkCacheMetaData> m_inserting;
+    QLockFile m_trimLock;
+};
+
+#endif // DISKCACHE_H
@@ -139,6 +139,20 @@ bool File::write(const QString& data)
     }
 }
 
+bool File::writeBytes(const QByteArray& bytes)
+{
+    if (!m_file->isWritable()) {
+        qDebug() << "File::writeBytes - "
+                 << "Couldn't write:" << m_file->fileName();
+        return false;
+    }
+    if (m_fileStream) {
+        // text file: keep the bytes after whatever is still in the stream buffer
+        m_fileStream->flush();
+    }
+    return m_file->write(bytes) == bytes.size();
+}
+
 bool File::seek(const qint64 pos)
 {
     if (m_fileStream) {
@@ -45,6 +45,9 @@ public:
     File(QFile* openfile, QTextCodec* codec, QObject* parent = 0);
     virtual ~File();
 
+    // write @p bytes as they are, whatever the mode the file was opened with
+    bool writeBytes(const QByteArray& bytes);
+
 public slots:
     /**
      * @param n Number of bytes to read (a negative value means read up to EOF)
@@ -0,0 +1,292 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "hostresolver.h"
+
+#include <QNetworkCookie>
+#include <QSslCertificate>
+#include <QStringList>
+#include <QUrl>
+
+// Qt's host cache answers from an entry for 60 seconds after the lookup
+// that made it, so lookups before that are no lookups at all
+#define QT_HOST_CACHE_MAX_AGE 60000
+// How late after Qt's entry expired a host is looked up again
+#define HOST_RESOLVER_REFRESH_INTERVAL 1000
+
+static HostResolver* hostResolverInstance = Q_NULLPTR;
+
+// public:
+HostResolver* HostResolver::instance()
+{
+    if (!hostResolverInstance) {
+        hostResolverInstance = new HostResolver();
+    }
+    return hostResolverInstance;
+}
+
+bool HostResolver::setRules(const QString& rules)
+{
+    QList<Rule> parsedRules;
+    foreach (const QString& entry, rules.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        const QStringList parts = entry.simplified().split(QLatin1Char(' '));
+        const QString kind = parts.first().toUpper();
+
+        Rule rule;
+        rule.port = -1;
+        if (kind == QLatin1String("EXCLUDE") && parts.size() == 2) {
+            rule.exclude = true;
+        } else if (kind == QLatin1String("MAP") && parts.size() == 3) {
+            const QUrl target(QLatin1String("//") + parts.at(2), QUrl::StrictMode);
+            if (!target.isValid() || target.host().isEmpty()) {
+                return false;
+            }
+            rule.exclude = false;
+            rule.host = target.host();
+            rule.port = target.port();
+        } else {
+            return false;
+        }
+        rule.pattern = QRegExp(parts.at(1), Qt::CaseInsensitive, QRegExp::Wildcard);
+        parsedRules += rule;
+    }
+
+    m_rules = parsedRules;
+    return true;
+}
+
+void HostResolver::setCacheTtl(int seconds)
+{
+    m_cacheTtl = qMax(seconds, 0);
+    if (m_cacheTtl == 0) {
+        m_cache.clear();
+        m_refreshTimer.stop();
+    }
+}
+
+int HostResolver::cacheTtl() const
+{
+    return m_cacheTtl;
+}
+
+void HostResolver::prefetch(const QStringList& hosts)
+{
+    foreach (const QString& host, hosts) {
+        keep(host.trimmed().toLower());
+    }
+}
+
+QUrl HostResolver::resolve(const QUrl& url)
+{
+    const QString scheme = url.scheme().toLower();
+    if (scheme != QLatin1String("http") && scheme != QLatin1String("https")) {
+        return url;
+    }
+
+    const QString host = url.host().toLower();
+    foreach (const Rule& rule, m_rules) {
+        if (!rule.pattern.exactMatch(host)) {
+            continue;
+        }
+        if (rule.exclude) {
+            break;
+        }
+
+        QUrl mappedUrl(url);
+        mappedUrl.setHost(rule.host);
+        if (rule.port >= 0) {
+            mappedUrl.setPort(rule.port);
+        }
+        ++m_mapped;
+        keep(rule.host.toLower());
+        return mappedUrl;
+    }
+
+    keep(host);
+    return url;
+}
+
+QVariantMap HostResolver::stats() const
+{
+    QVariantMap hosts;
+    QHash<QString, Entry>::const_iterator it = m_cache.constBegin();
+    for (; it != m_cache.constEnd(); ++it) {
+        QStringList addresses;
+        foreach (const QHostAddress& address, it.value().addresses) {
+            addresses += address.toString();
+        }
+        hosts[it.key()] = addresses;
+    }
+
+    QVariantMap result;
+    result["mapped"] = m_mapped;
+    result["hosts"] = hosts;
+    result["lookups"] = m_lookups;
+    result["failures"] = m_failures;
+    return result;
+}
+
+// private slots:
+void HostResolver::refresh()
+{
+    QHash<QString, Entry>::iterator it = m_cache.begin();
+    while (it != m_cache.end()) {
+        if (it.value().lastUsed.hasExpired(qint64(m_cacheTtl) * 1000)) {
+            it = m_cache.erase(it);
+            continue;
+        }
+        // Not before Qt's entry has expired, or not yet looked up at all
+        if (it.value().lookedUp.isValid() && it.value().lookedUp.hasExpired(QT_HOST_CACHE_MAX_AGE)) {
+            lookup(it.key());
+        }
+        ++it;
+    }
+
+    if (m_cache.isEmpty()) {
+        m_refreshTimer.stop();
+    }
+}
+
+void HostResolver::lookedUp(const QHostInfo& info)
+{
+    const QString host = info.hostName().toLower();
+    m_pending.remove(host);
+
+    QHash<QString, Entry>::iterator it = m_cache.find(host);
+    if (it != m_cache.end()) {
+        it.value().lookedUp.start();
+    }
+
+    // The addresses looked up before are still good to show
+    if (info.error() != QHostInfo::NoError) {
+        ++m_failures;
+        return;
+    }
+
+    if (it != m_cache.end()) {
+        it.value().addresses = info.addresses();
+    }
+}
+
+// private:
+HostResolver::HostResolver()
+    : QObject(Q_NULLPTR)
+    , m_cacheTtl(0)
+    , m_mapped(0)
+    , m_lookups(0)
+    , m_failures(0)
+{
+    m_refreshTimer.setInterval(HOST_RESOLVER_REFRESH_INTERVAL);
+    connect(&m_refreshTimer, SIGNAL(timeout()), SLOT(refresh()));
+}
+
+void HostResolver::keep(const QString& host)
+{
+    // Addresses need no lookup
+    if (m_cacheTtl == 0 || host.isEmpty() || !QHostAddress(host).isNull()) {
+        return;
+    }
+
+    QHash<QString, Entry>::iterator it = m_cache.find(host);
+    if (it != m_cache.end()) {
+        it.value().lastUsed.restart();
+        return;
+    }
+
+    Entry entry;
+    entry.lastUsed.start();
+    m_cache.insert(host, entry);
+    lookup(host);
+
+    if (!m_refreshTimer.isActive()) {
+        m_refreshTimer.start();
+    }
+}
+
+void HostResolver::lookup(const QString& host)
+{
+    if (m_pending.contains(host)) {
+        return;
+    }
+    m_pending += host;
+    ++m_lookups;
+    QHostInfo::lookupHost(host, this, SLOT(lookedUp(QHostInfo)));
+}
+
+// ResolvedReply
+
+// Whether the certificate names the host, "*." standing for one label
+static bool isCertificateFor(const QSslCertificate& certificate, const QString& host)
+{
+    QStringList names = certificate.subjectAlternativeNames().values(QSsl::DnsEntry);
+    names += certificate.subjectInfo(QSslCertificate::CommonName);
+    foreach (const QString& name, names) {
+        const QString lowerName = name.toLower();
+        if (lowerName == host) {
+            return true;
+        }
+        if (lowerName.startsWith(QLatin1String("*.")) && host.endsWith(lowerName.mid(1))
+            && host.indexOf(QLatin1Char('.')) == host.length() - lowerName.length() + 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ResolvedReply::ResolvedReply(QNetworkReply* reply, const QNetworkRequest& request, QNetworkCookieJar* cookieJar)
+    : ProxyReply(reply->parent(), request, reply->operation())
+    , m_cookieJar(cookieJar)
+{
+    connect(reply, SIGNAL(sslErrors(const QList<QSslError>&)), SLOT(checkSslErrors(const QList<QSslError>&)));
+    setReply(reply);
+    setUrl(request.url());
+}
+
+// protected:
+void ResolvedReply::metaDataReceived()
+{
+    // Qt would keep them for the host the request was sent to
+    const QList<QNetworkCookie> cookies = QNetworkCookie::parseCookies(rawHeader("Set-Cookie"));
+    if (m_cookieJar && !cookies.isEmpty()) {
+        m_cookieJar->setCookiesFromUrl(cookies, url());
+    }
+}
+
+// private slots:
+void ResolvedReply::checkSslErrors(const QList<QSslError>& errors)
+{
+    const QString host = url().host().toLower();
+    foreach (const QSslError& error, errors) {
+        if (error.error() != QSslError::HostNameMismatch || !isCertificateFor(error.certificate(), host)) {
+            return;
+        }
+    }
+    reply()->ignoreSslErrors(errors);
+}
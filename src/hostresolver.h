@@ -0,0 +1,161 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef HOSTRESOLVER_H
+#define HOSTRESOLVER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QList>
+#include <QNetworkCookieJar>
+#include <QObject>
+#include <QPointer>
+#include <QRegExp>
+#include <QSet>
+#include <QSslError>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "proxyreply.h"
+
+/**
+ * Where the requests of all the pages of the process go.
+ *
+ * Host resolver rules send the requests to some hosts to another host
+ * and port instead, e.g. to a local stand-in for a backend. They are
+ * comma separated and tried in order:
+ *   "MAP <pattern> <host>[:<port>]" maps the hosts matching the pattern,
+ *   "EXCLUDE <pattern>" keeps the hosts matching it from the rules after.
+ * Patterns are wildcards, as in "*.example.com".
+ *
+ * The DNS cache keeps the hosts used in the last TTL seconds, and those
+ * prefetched, in Qt's own host cache, which the network requests go
+ * through: each is looked up again about a second after Qt lets its
+ * addresses expire. A request to one of them can still wait for a lookup
+ * in that second, or while the lookup goes on; and, once, for a host Qt
+ * had looked up before it was kept, as the first lookup here is then
+ * answered from Qt's entry.
+ */
+class HostResolver : public QObject {
+    Q_OBJECT
+
+public:
+    static HostResolver* instance();
+
+    /**
+     * @return false, leaving the rules as they were, if they do not parse
+     */
+    bool setRules(const QString& rules);
+
+    /**
+     * @param seconds how long an unused host is kept resolved, 0 (default)
+     *        for no cache
+     */
+    void setCacheTtl(int seconds);
+    int cacheTtl() const;
+
+    // Look the hosts up now, keeping them for the TTL
+    void prefetch(const QStringList& hosts);
+
+    /**
+     * The URL a request to this one is sent to, as mapped by the rules;
+     * this one if no rule maps it, or it is not HTTP(S).
+     * Either way, its host is kept resolved for the TTL.
+     */
+    QUrl resolve(const QUrl& url);
+
+    /**
+     * Requests mapped, hosts cached and their addresses, lookups made and
+     * those which failed.
+     */
+    QVariantMap stats() const;
+
+private slots:
+    void refresh();
+    void lookedUp(const QHostInfo& info);
+
+private:
+    HostResolver();
+
+    void keep(const QString& host);
+    void lookup(const QString& host);
+
+    struct Rule {
+        QRegExp pattern;
+        bool exclude;
+        QString host;
+        int port;
+    };
+
+    struct Entry {
+        QList<QHostAddress> addresses;
+        QElapsedTimer lastUsed;
+        // Since the last lookup finished, invalid before the first one
+        QElapsedTimer lookedUp;
+    };
+
+    QList<Rule> m_rules;
+    int m_cacheTtl;
+    QHash<QString, Entry> m_cache;
+    // Lookups going on
+    QSet<QString> m_pending;
+    QTimer m_refreshTimer;
+    int m_mapped;
+    int m_lookups;
+    int m_failures;
+};
+
+/**
+ * Reply to a request sent elsewhere by the host resolver rules, standing
+ * for the request as it was made: it has its URL, and the cookies are
+ * those of its host.
+ *
+ * For HTTPS, a certificate for the host of the original request is taken
+ * as valid though it does not match the host it came from.
+ */
+class ResolvedReply : public ProxyReply {
+    Q_OBJECT
+
+public:
+    ResolvedReply(QNetworkReply* reply, const QNetworkRequest& request, QNetworkCookieJar* cookieJar);
+
+protected:
+    void metaDataReceived();
+
+private slots:
+    void checkSslErrors(const QList<QSslError>& errors);
+
+private:
+    QPointer<QNetworkCookieJar> m_cookieJar;
+};
+
+#endif // HOSTRESOLVER_H
@@ -0,0 +1,230 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "memorycache.h"
+
+#include <QBuffer>
+#include <QCache>
+
+#include <climits>
+
+struct CachedResponse {
+    QNetworkCacheMetaData metaData;
+    QByteArray data;
+};
+
+// Costs are in bytes
+static QCache<QUrl, CachedResponse>& store()
+{
+    static QCache<QUrl, CachedResponse> responses(0);
+    return responses;
+}
+
+static struct {
+    qint64 hits;
+    qint64 misses;
+} memoryCacheStats = { 0, 0 };
+
+static QUrl cacheKey(const QUrl& url)
+{
+    return url.adjusted(QUrl::RemoveFragment | QUrl::RemovePassword);
+}
+
+static void keep(const QNetworkCacheMetaData& metaData, const QByteArray& data)
+{
+    CachedResponse* response = new CachedResponse;
+    response->metaData = metaData;
+    response->data = data;
+    // Takes ownership, and drops it right away if larger than the whole budget
+    store().insert(cacheKey(metaData.url()), response, data.size());
+}
+
+static QIODevice* reader(const QByteArray& data)
+{
+    QBuffer* buffer = new QBuffer;
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+// public:
+MemoryCache::MemoryCache(QAbstractNetworkCache* backingCache, QObject* parent)
+    : QAbstractNetworkCache(parent)
+    , m_backingCache(backingCache)
+{
+    if (m_backingCache) {
+        m_backingCache->setParent(this);
+    }
+}
+
+MemoryCache::~MemoryCache()
+{
+    qDeleteAll(m_inserting.keys());
+}
+
+QNetworkCacheMetaData MemoryCache::metaData(const QUrl& url)
+{
+    CachedResponse* response = store().object(cacheKey(url));
+    if (response) {
+        return response->metaData;
+    }
+    return m_backingCache ? m_backingCache->metaData(url) : QNetworkCacheMetaData();
+}
+
+void MemoryCache::updateMetaData(const QNetworkCacheMetaData& metaData)
+{
+    CachedResponse* response = store().object(cacheKey(metaData.url()));
+    if (response) {
+        response->metaData = metaData;
+    }
+    if (m_backingCache) {
+        m_backingCache->updateMetaData(metaData);
+    }
+}
+
+QIODevice* MemoryCache::data(const QUrl& url)
+{
+    CachedResponse* response = store().object(cacheKey(url));
+    if (response) {
+        ++memoryCacheStats.hits;
+        return reader(response->data);
+    }
+    ++memoryCacheStats.misses;
+
+    if (!m_backingCache) {
+        return Q_NULLPTR;
+    }
+    QIODevice* device = m_backingCache->data(url);
+    if (!device) {
+        return Q_NULLPTR;
+    }
+
+    // Next time, spare the disk
+    const QByteArray data = device->readAll();
+    delete device;
+    keep(m_backingCache->metaData(url), data);
+    return reader(data);
+}
+
+bool MemoryCache::remove(const QUrl& url)
+{
+    QHash<QIODevice*, Pending>::iterator it = m_inserting.begin();
+    while (it != m_inserting.end()) {
+        if (it.value().metaData.url() == url) {
+            delete it.key();
+            it = m_inserting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    bool removed = store().remove(cacheKey(url));
+    if (m_backingCache) {
+        removed = m_backingCache->remove(url) || removed;
+    }
+    return removed;
+}
+
+qint64 MemoryCache::cacheSize() const
+{
+    return store().totalCost() + (m_backingCache ? m_backingCache->cacheSize() : 0);
+}
+
+QIODevice* MemoryCache::prepare(const QNetworkCacheMetaData& metaData)
+{
+    // "no-store" responses are not to be kept anywhere
+    if (!metaData.isValid() || !metaData.url().isValid() || !metaData.saveToDisk()) {
+        return Q_NULLPTR;
+    }
+
+    Pending pending;
+    pending.metaData = metaData;
+    pending.backingDevice = m_backingCache ? m_backingCache->prepare(metaData) : Q_NULLPTR;
+
+    QBuffer* buffer = new QBuffer;
+    buffer->open(QIODevice::ReadWrite);
+    m_inserting.insert(buffer, pending);
+    return buffer;
+}
+
+void MemoryCache::insert(QIODevice* device)
+{
+    QHash<QIODevice*, Pending>::iterator it = m_inserting.find(device);
+    if (it == m_inserting.end()) {
+        return;
+    }
+    const Pending pending = it.value();
+    m_inserting.erase(it);
+
+    const QByteArray data = static_cast<QBuffer*>(device)->data();
+    delete device;
+    keep(pending.metaData, data);
+
+    if (pending.backingDevice) {
+        pending.backingDevice->write(data);
+        m_backingCache->insert(pending.backingDevice);
+    }
+}
+
+qint64 MemoryCache::maximumCacheSize()
+{
+    return store().maxCost();
+}
+
+void MemoryCache::setMaximumCacheSize(qint64 size)
+{
+    store().setMaxCost(int(qMin(size, qint64(INT_MAX))));
+}
+
+QVariantMap MemoryCache::stats()
+{
+    QVariantMap result;
+    result["hits"] = memoryCacheStats.hits;
+    result["misses"] = memoryCacheStats.misses;
+    result["size"] = store().totalCost();
+    result["count"] = store().count();
+    return result;
+}
+
+void MemoryCache::clearStore()
+{
+    store().clear();
+}
+
+void MemoryCache::clear()
+{
+    qDeleteAll(m_inserting.keys());
+    m_inserting.clear();
+
+    store().clear();
+    if (m_backingCache) {
+        m_backingCache->clear();
+    }
+}
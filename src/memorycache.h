@@ -0,0 +1,100 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef MEMORYCACHE_H
+#define MEMORYCACHE_H
+
+#include <QAbstractNetworkCache>
+#include <QHash>
+#include <QVariantMap>
+
+/**
+ * In-memory cache shared by all the pages of the process, in front of an
+ * optional disk cache.
+ *
+ * Every NetworkAccessManager owns its own MemoryCache, as Qt requires, but
+ * they all keep the responses in one store, with one byte budget: an
+ * asset loaded by one page is served from RAM to the next ones. When the
+ * store is full, the least recently used responses make room.
+ *
+ * Qt decides, from the metadata and so from Cache-Control, whether a
+ * cached response can be used as is or needs revalidating; responses
+ * marked "no-store" are never kept.
+ */
+class MemoryCache : public QAbstractNetworkCache {
+    Q_OBJECT
+
+public:
+    /**
+     * @param backingCache cache behind the memory one, owned from now on, or none
+     */
+    MemoryCache(QAbstractNetworkCache* backingCache, QObject* parent = Q_NULLPTR);
+    virtual ~MemoryCache();
+
+    QNetworkCacheMetaData metaData(const QUrl& url);
+    void updateMetaData(const QNetworkCacheMetaData& metaData);
+    QIODevice* data(const QUrl& url);
+    bool remove(const QUrl& url);
+    qint64 cacheSize() const;
+
+    QIODevice* prepare(const QNetworkCacheMetaData& metaData);
+    void insert(QIODevice* device);
+
+    /**
+     * Byte budget of the store shared by all the memory caches.
+     */
+    static qint64 maximumCacheSize();
+    static void setMaximumCacheSize(qint64 size);
+
+    /**
+     * "hits", "misses", and the "size" and "count" of the responses kept.
+     */
+    static QVariantMap stats();
+
+    /**
+     * Empties the store shared by all the memory caches, leaving the disk
+     * caches behind them alone.
+     */
+    static void clearStore();
+
+public slots:
+    void clear();
+
+private:
+    struct Pending {
+        QNetworkCacheMetaData metaData;
+        QIODevice* backingDevice;
+    };
+
+    QAbstractNetworkCache* m_backingCache;
+    QHash<QIODevice*, Pending> m_inserting;
+};
+
+#endif // MEMORYCACHE_H
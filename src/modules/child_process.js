@@ -149,6 +149,9 @@ function newContext() {
 
   // Emulates `Writable Stream`
   function FakeWritableStream() {
+    // Used by native code writing raw bytes, e.g. WebPage#renderTo
+    this._context = ctx
+
     /**
      * @param chunk String Data to write.
      * @param encoding String Optional.  Defaults to "utf8".
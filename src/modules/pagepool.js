@@ -0,0 +1,171 @@
+/*jslint sloppy: true, nomen: true */
+/*global exports:true,require:true,setTimeout:true,clearTimeout:true */
+
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+var webpage = require('webpage'),
+    cookiejar = require('cookiejar');
+
+/* Creates a pool of pre-warmed pages that run queued jobs.
+ *
+ * opts (all optional):
+ *  - size: number of pages, i.e. how many jobs run at the same time (default 1)
+ *  - timeout: milliseconds a job may run before it fails with a "timeout"
+ *    error and its page is replaced (default 0, no limit)
+ *  - pageOptions: properties copied into every page, as for webpage.create()
+ *  - isolateCookies: give every page its own cookie jar, cleared between
+ *    jobs (default true)
+ */
+exports.create = function (opts) {
+    opts = opts || {};
+
+    var size = Math.max(1, parseInt(opts.size, 10) || 1),
+        timeout = Math.max(0, parseInt(opts.timeout, 10) || 0),
+        isolateCookies = opts.isolateCookies !== false,
+        idle = [],
+        queue = [],
+        active = 0,
+        closed = false,
+        pool = {};
+
+    function createPage() {
+        var page = webpage.create(opts.pageOptions);
+        if (isolateCookies) {
+            page.cookieJar = cookiejar.create();
+        }
+        return page;
+    }
+
+    function release(page) {
+        page.reset();
+        if (isolateCookies) {
+            page.cookieJar.clearCookies();
+        }
+        return page;
+    }
+
+    function dispatch() {
+        while (!closed && idle.length > 0 && queue.length > 0) {
+            run(idle.shift(), queue.shift());
+        }
+    }
+
+    function run(page, job) {
+        var finished = false,
+            timer = null;
+
+        function finish(err, result, timedOut) {
+            if (finished) {
+                return;
+            }
+            finished = true;
+            active -= 1;
+            if (timer !== null) {
+                clearTimeout(timer);
+            }
+
+            if (closed) {
+                page.close();
+            } else if (timedOut) {
+                // The page might still be busy with the job: start over
+                page.close();
+                idle.push(createPage());
+            } else {
+                idle.push(release(page));
+            }
+
+            if (typeof job.callback === 'function') {
+                job.callback(err, result);
+            }
+
+            // Do not grow the stack when jobs complete synchronously
+            setTimeout(dispatch, 0);
+        }
+
+        active += 1;
+        if (timeout > 0) {
+            timer = setTimeout(function () {
+                finish(new Error('timeout'), undefined, true);
+            }, timeout);
+        }
+
+        try {
+            job.fn(page, function (err, result) {
+                finish(err || null, result, false);
+            });
+        } catch (e) {
+            finish(e, undefined, false);
+        }
+    }
+
+    /* Queues "fn(page, done)" to run on the next free page.
+     * The job calls "done(err, result)" when it is finished with the page,
+     * after which "callback(err, result)" is invoked and the page is reset
+     * for the next job.
+     */
+    pool.run = function (fn, callback) {
+        if (closed) {
+            throw new Error('Page pool is closed');
+        }
+        if (typeof fn !== 'function') {
+            throw new Error('Job must be a function');
+        }
+        queue.push({ fn: fn, callback: callback });
+        dispatch();
+    };
+
+    /* Closes the idle pages and drops the jobs that did not start yet.
+     * Pages still running a job are closed when the job is done.
+     */
+    pool.close = function () {
+        closed = true;
+        queue = [];
+        idle.forEach(function (page) {
+            page.close();
+        });
+        idle = [];
+    };
+
+    Object.defineProperty(pool, 'size', {
+        get: function () { return size; }
+    });
+    Object.defineProperty(pool, 'pending', {
+        get: function () { return queue.length; }
+    });
+    Object.defineProperty(pool, 'active', {
+        get: function () { return active; }
+    });
+
+    while (idle.length < size) {
+        idle.push(createPage());
+    }
+
+    return pool;
+};
@@ -0,0 +1,304 @@
+/*jslint sloppy: true, nomen: true */
+/*global exports:true,require:true,phantom:true,console:true,setTimeout:true */
+
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+var system = require('system'),
+    childProcess = require('child_process');
+
+// Messages between supervisor and workers are single JSON lines. Workers
+// write theirs to stdout, where they share the pipe with console.log():
+// the prefix tells them apart.
+var MESSAGE_PREFIX = '#phantomjs-supervisor# ';
+
+// Bytes of a worker's stderr kept to explain why it died
+var STDERR_TAIL_SIZE = 4096;
+
+function toError(value) {
+    if (value === null || typeof value === 'undefined') {
+        return null;
+    }
+    var err = new Error(typeof value === 'object' ? value.message : String(value));
+    if (typeof value === 'object' && value.stack) {
+        err.stack = value.stack;
+    }
+    return err;
+}
+
+/* Starts "opts.workers" phantomjs processes running "opts.script" and
+ * spreads the jobs given to "run()" over them, one job per worker at a time.
+ *
+ * opts:
+ *  - script: worker script, which calls serve() (mandatory)
+ *  - args: extra command line arguments for the workers
+ *  - workers: number of worker processes (default 1)
+ *  - maxJobs: jobs after which a worker is replaced (default 0, no limit)
+ *  - maxMemory: resident memory in bytes after which a worker is replaced
+ *    (default 0, no limit)
+ *  - restartDelay: milliseconds to wait before replacing a worker that
+ *    died unexpectedly (default 1000)
+ *  - executable: phantomjs binary (default: the running one)
+ */
+exports.create = function (opts) {
+    opts = opts || {};
+    if (typeof opts.script !== 'string') {
+        throw new Error('Worker script missing');
+    }
+
+    var size = Math.max(1, parseInt(opts.workers, 10) || 1),
+        maxJobs = Math.max(0, parseInt(opts.maxJobs, 10) || 0),
+        maxMemory = Math.max(0, parseInt(opts.maxMemory, 10) || 0),
+        restartDelay = typeof opts.restartDelay === 'number' ? opts.restartDelay : 1000,
+        executable = opts.executable || system.executablePath,
+        args = [opts.script].concat(opts.args || []),
+        workers = [],
+        queue = [],
+        nextJobId = 1,
+        closed = false,
+        supervisor = {};
+
+    function dispatch() {
+        var i, worker;
+        for (i = 0; i < workers.length && queue.length > 0; i += 1) {
+            worker = workers[i];
+            if (worker.ready && !worker.job && !worker.retiring) {
+                worker.job = queue.shift();
+                worker.ctx.stdin.write(JSON.stringify({
+                    id: worker.job.id,
+                    data: worker.job.data
+                }) + '\n');
+            }
+        }
+    }
+
+    function retire(worker) {
+        worker.retiring = true;
+        // The worker exits once it reads the end of its input
+        worker.ctx.stdin.end();
+    }
+
+    function onMessage(worker, message) {
+        var job = worker.job;
+
+        if (message.type === 'ready') {
+            worker.ready = true;
+        } else if (message.type === 'result' && job && job.id === message.id) {
+            worker.job = null;
+            worker.jobs += 1;
+            if ((maxJobs > 0 && worker.jobs >= maxJobs) ||
+                    (maxMemory > 0 && message.memory >= maxMemory)) {
+                retire(worker);
+            }
+            if (typeof job.callback === 'function') {
+                job.callback(toError(message.error), message.result);
+            }
+        }
+        dispatch();
+    }
+
+    function onExit(worker, code) {
+        var job = worker.job,
+            index = workers.indexOf(worker),
+            err;
+
+        // A process failing to start reports both an error and its exit
+        if (index < 0) {
+            return;
+        }
+        workers.splice(index, 1);
+
+        if (typeof supervisor.onWorkerExit === 'function') {
+            supervisor.onWorkerExit({
+                pid: worker.pid,
+                code: code,
+                crashed: worker.ctx.crashed,
+                recycled: worker.retiring,
+                jobs: worker.jobs,
+                stderr: worker.stderr
+            });
+        }
+
+        if (job) {
+            err = new Error(worker.ctx.crashed ? 'Worker crashed' : 'Worker exited with code ' + code);
+            err.pid = worker.pid;
+            err.stderr = worker.stderr;
+            if (typeof job.callback === 'function') {
+                job.callback(err);
+            }
+        }
+
+        if (!closed) {
+            if (worker.retiring) {
+                spawn();
+            } else {
+                setTimeout(function () {
+                    if (!closed) {
+                        spawn();
+                        dispatch();
+                    }
+                }, restartDelay);
+            }
+        }
+        dispatch();
+    }
+
+    function spawn() {
+        var ctx = childProcess.spawn(executable, args),
+            worker = {
+                ctx: ctx,
+                pid: ctx.pid,
+                ready: false,
+                retiring: false,
+                job: null,
+                jobs: 0,
+                stdout: '',
+                stderr: ''
+            };
+
+        ctx.stdout.on('data', function (chunk) {
+            var lines = (worker.stdout + chunk).split('\n');
+            worker.stdout = lines.pop();
+            lines.forEach(function (line) {
+                if (line.indexOf(MESSAGE_PREFIX) === 0) {
+                    try {
+                        onMessage(worker, JSON.parse(line.substring(MESSAGE_PREFIX.length)));
+                    } catch (e) {
+                        console.error('Invalid message from worker ' + worker.pid + ': ' + e);
+                    }
+                } else {
+                    system.stdout.writeLine(line);
+                }
+            });
+        });
+
+        ctx.stderr.on('data', function (chunk) {
+            system.stderr.write(chunk);
+            worker.stderr = (worker.stderr + chunk).slice(-STDERR_TAIL_SIZE);
+        });
+
+        ctx.on('exit', function (code) {
+            onExit(worker, code);
+        });
+
+        workers.push(worker);
+        return worker;
+    }
+
+    /* Queues "data" (anything JSON can carry) for the next free worker.
+     * "callback(err, result)" is invoked with what the worker's handler
+     * passed to "done()", or with an error if the worker died meanwhile.
+     */
+    supervisor.run = function (data, callback) {
+        if (closed) {
+            throw new Error('Supervisor is closed');
+        }
+        queue.push({ id: nextJobId, data: data, callback: callback });
+        nextJobId += 1;
+        dispatch();
+    };
+
+    /* Drops the queued jobs and lets every worker exit once its current
+     * job is done.
+     */
+    supervisor.close = function () {
+        closed = true;
+        queue = [];
+        workers.forEach(function (worker) {
+            if (!worker.retiring) {
+                retire(worker);
+            }
+        });
+    };
+
+    Object.defineProperty(supervisor, 'workers', {
+        get: function () {
+            return workers.map(function (worker) { return worker.pid; });
+        }
+    });
+    Object.defineProperty(supervisor, 'pending', {
+        get: function () { return queue.length; }
+    });
+
+    while (workers.length < size) {
+        spawn();
+    }
+
+    return supervisor;
+};
+
+/* Turns the running script into a worker of a supervisor: "handler(data,
+ * done)" is called for each job and calls "done(err, result)" when it is
+ * finished. The process exits when the supervisor closes its input.
+ */
+exports.serve = function (handler) {
+    function send(message) {
+        system.stdout.write(MESSAGE_PREFIX + JSON.stringify(message) + '\n');
+        system.stdout.flush();
+    }
+
+    function next() {
+        // Blocks until the supervisor has a job for us: there is nothing
+        // else to do in between.
+        var line = system.stdin.readLine(),
+            job,
+            finished = false;
+
+        if (!line) {
+            phantom.exit(0);
+            return;
+        }
+
+        job = JSON.parse(line);
+
+        function done(err, result) {
+            if (finished) {
+                return;
+            }
+            finished = true;
+            send({
+                type: 'result',
+                id: job.id,
+                error: err ? { message: err.message || String(err), stack: err.stack } : null,
+                result: result,
+                memory: system.residentSetSize
+            });
+            setTimeout(next, 0);
+        }
+
+        try {
+            handler(job.data, done);
+        } catch (e) {
+            done(e);
+        }
+    }
+
+    send({ type: 'ready' });
+    setTimeout(next, 0);
+};
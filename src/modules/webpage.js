@@ -261,6 +261,8 @@ function decorateNewPage(opts, page) {
 
     definePageSignalHandler(page, handlers, "onResourceTimeout", "resourceTimeout");
 
+    definePageSignalHandler(page, handlers, "onNetworkIdle", "networkIdle");
+
     definePageSignalHandler(page, handlers, "onAlert", "javaScriptAlertSent");
 
     definePageSignalHandler(page, handlers, "onConsoleMessage", "javaScriptConsoleMessageSent");
@@ -421,6 +423,20 @@ function decorateNewPage(opts, page) {
         this.evaluate.apply(this, args);
     };
 
+    /**
+     * render the page straight into a writable target, with no base64 step
+     * @param {object} target   a file opened for writing, a webserver response or a child process stdin
+     * @param {object} options  same options as render(); format defaults to "png"
+     * @return {boolean}        true if the page has been rendered successfully
+     */
+    page.renderTo = function (target, options) {
+        if (target && target._context) {
+            // child process stdin: write to the underlying process
+            target = target._context;
+        }
+        return this._renderTo(target, options || {});
+    };
+
     /**
      * upload a file
      * @param {string}       selector  css selector for the file input element
@@ -434,6 +450,33 @@ function decorateNewPage(opts, page) {
         this._uploadFile(selector, fileNames);
     };
 
+    /**
+     * Brings the page back to the state of a freshly created one, so it can
+     * be reused for another job: handlers are removed, a blank document is
+     * loaded with an empty history, and settings and the options the page
+     * was created with are applied again.
+     * Cookies are left to the page's cookie jar.
+     */
+    page.reset = function() {
+        var handlerName;
+
+        for (handlerName in handlers) {
+            if (handlers.hasOwnProperty(handlerName)) {
+                this[handlerName] = null;
+            }
+        }
+        this.onPageCreated = null;
+        this.onError = phantom.defaultErrorHandler;
+
+        this._reset();
+
+        // deep copy
+        this.settings = JSON.parse(JSON.stringify(phantom.defaultPageSettings));
+        if (opts) {
+            copyInto(this, opts);
+        }
+    };
+
     // Copy options into page
     if (opts) {
         page = copyInto(page, opts);
@@ -37,7 +37,8 @@
 
 exports.create = function (opts) {
     var server = phantom.createWebServer(),
-        handlers = {};
+        handlers = {},
+        streamBody = false;
 
     function checkType(o, type) {
         return typeof o === type;
@@ -94,7 +95,7 @@ exports.create = function (opts) {
         return target;
     }
 
-    function defineSetter(handlerName, signalName) {
+    function defineSetter(handlerName, signalName, wrap) {
         Object.defineProperty(server, handlerName, {
             set: function (f) {
                 if (handlers && typeof handlers[signalName] === 'function') {
@@ -102,20 +103,47 @@ exports.create = function (opts) {
                         this[signalName].disconnect(handlers[signalName]);
                     } catch (e) {}
                 }
-                handlers[signalName] = f;
+                handlers[signalName] = wrap ? wrap(f) : f;
                 this[signalName].connect(handlers[signalName]);
             }
         });
     }
 
-    defineSetter("onNewRequest", "newRequest");
+    // When request bodies are streamed, they are delivered through
+    // request.on('data'), request.on('end') and request.on('error').
+    function decorateRequestHandler(f) {
+        return function (request, response) {
+            if (streamBody) {
+                request.on = function (evt, cb) {
+                    switch (evt) {
+                    case 'data':
+                        response.bodyData.connect(cb);
+                        break;
+                    case 'end':
+                        response.bodyEnd.connect(cb);
+                        break;
+                    case 'error':
+                        response.bodyError.connect(cb);
+                        break;
+                    default:
+                        break;
+                    }
+                };
+            }
+            return f.call(this, request, response);
+        };
+    }
+
+    defineSetter("onNewRequest", "newRequest", decorateRequestHandler);
 
     server.listen = function (port, arg1, arg2) {
         if (arguments.length === 2 && typeof arg1 === 'function') {
+            streamBody = false;
             this.onNewRequest = arg1;
             return this.listenOnPort(port, {});
         }
         if (arguments.length === 3 && typeof arg2 === 'function') {
+            streamBody = !!(arg1 && arg1.streamBody);
             this.onNewRequest = arg2;
             // arg1 == settings
             return this.listenOnPort(port, arg1);
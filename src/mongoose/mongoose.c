@@ -403,7 +403,7 @@ enum {
   SSL_CHAIN_FILE, ENABLE_DIRECTORY_LISTING, ERROR_LOG_FILE,
   GLOBAL_PASSWORDS_FILE, INDEX_FILES,
   ENABLE_KEEP_ALIVE, ACCESS_CONTROL_LIST, MAX_REQUEST_SIZE,
-  EXTRA_MIME_TYPES, LISTENING_PORTS,
+  EXTRA_MIME_TYPES, LISTENING_PORTS, SOCKET_QUEUE_SIZE,
   DOCUMENT_ROOT, SSL_CERTIFICATE, NUM_THREADS, RUN_AS_USER,
   NUM_OPTIONS
 };
@@ -427,6 +427,7 @@ static const char *config_options[] = {
   "M", "max_request_size", "16384",
   "m", "extra_mime_types", NULL,
   "p", "listening_ports", "8080",
+  "q", "socket_queue_size", "20",
   "r", "document_root",  ".",
   "s", "ssl_certificate", NULL,
   "t", "num_threads", "10",
@@ -448,7 +449,8 @@ struct mg_context {
   pthread_mutex_t mutex;     // Protects (max|num)_threads
   pthread_cond_t  cond;      // Condvar for tracking workers terminations
 
-  struct socket queue[20];   // Accepted sockets
+  struct socket *queue;      // Accepted sockets
+  int queue_size;            // Number of sockets the queue can hold
   volatile int sq_head;      // Head of the socket queue
   volatile int sq_tail;      // Tail of the socket queue
   pthread_cond_t sq_full;    // Singaled when socket is produced
@@ -465,6 +467,9 @@ struct mg_connection {
   int64_t num_bytes_sent;     // Total bytes sent to client
   int64_t content_len;        // Content-Length header value
   int64_t consumed_content;   // How many bytes of content is already read
+  int chunked;                // 1 for a chunked body, 2 once fully read, 3 if malformed
+  int64_t chunk_remaining;    // Bytes left to read in the current chunk
+  int must_close;             // 1 not to keep the connection alive after this request
   char *buf;                  // Buffer for received data
   int buf_size;               // Buffer size
   int request_len;            // Size of the request + headers in a buffer
@@ -784,6 +789,13 @@ static int match_extension(const char *path, const char *ext_list) {
 static int should_keep_alive(const struct mg_connection *conn) {
   const char *http_version = conn->request_info.http_version;
   const char *header = mg_get_header(conn, "Connection");
+  if (conn->must_close) {
+    return 0;
+  }
+  if (conn->chunked != 0 && conn->chunked != 2) {
+    // The end of a chunked body that was not read is unknown
+    return 0;
+  }
   return (header == NULL && http_version && !strcmp(http_version, "1.1")) ||
       (header != NULL && !mg_strcasecmp(header, "keep-alive"));
 }
@@ -1369,10 +1381,109 @@ static int pull(FILE *fp, SOCKET sock, SSL *ssl, char *buf, int len) {
   return nread;
 }
 
+// Read raw body data: first what is left in the request buffer, then
+// from the socket. Only used for chunked bodies, where consumed_content
+// counts the raw bytes read so far.
+static int pull_body(struct mg_connection *conn, char *buf, int len) {
+  int64_t buffered_len;
+  int n;
+
+  buffered_len = (int64_t) (conn->data_len - conn->request_len) -
+    conn->consumed_content;
+  if (buffered_len > 0) {
+    n = buffered_len < len ? (int) buffered_len : len;
+    memcpy(buf, conn->buf + conn->request_len + conn->consumed_content, n);
+  } else {
+    n = pull(NULL, conn->client.sock, conn->ssl, buf, len);
+  }
+  if (n > 0) {
+    conn->consumed_content += n;
+  }
+  return n;
+}
+
+// Read one CRLF terminated line of a chunked body. Overlong lines are
+// truncated, this only happens with chunk extensions we ignore anyway.
+// Return line length, or -1 if the connection went away.
+static int pull_chunk_line(struct mg_connection *conn, char *line, int size) {
+  int len = 0;
+  char c;
+
+  for (;;) {
+    if (pull_body(conn, &c, 1) != 1) {
+      return -1;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (len < size - 1) {
+      line[len++] = c;
+    }
+  }
+  if (len > 0 && line[len - 1] == '\r') {
+    len--;
+  }
+  line[len] = '\0';
+  return len;
+}
+
+static int read_chunked(struct mg_connection *conn, char *buf, size_t len) {
+  char line[64], *end;
+  int n, nread = 0;
+
+  while (len > 0 && conn->chunked == 1) {
+    if (conn->chunk_remaining == 0) {
+      if (pull_chunk_line(conn, line, sizeof(line)) <= 0) {
+        conn->chunked = 3;
+        break;
+      }
+      conn->chunk_remaining = strtoll(line, &end, 16);
+      if (end == line || conn->chunk_remaining < 0) {
+        conn->chunked = 3;
+        break;
+      }
+      if (conn->chunk_remaining == 0) {
+        // Last chunk: skip trailers, up to the final empty line
+        while ((n = pull_chunk_line(conn, line, sizeof(line))) > 0) {
+        }
+        conn->chunked = n == 0 ? 2 : 3;
+        break;
+      }
+    }
+
+    n = pull_body(conn, buf, conn->chunk_remaining < (int64_t) len ?
+                  (int) conn->chunk_remaining : (int) len);
+    if (n <= 0) {
+      conn->chunked = 3;
+      break;
+    }
+    buf += n;
+    len -= n;
+    nread += n;
+    conn->chunk_remaining -= n;
+
+    // Chunk data is followed by CRLF
+    if (conn->chunk_remaining == 0 &&
+        pull_chunk_line(conn, line, sizeof(line)) != 0) {
+      conn->chunked = 3;
+      break;
+    }
+  }
+  return nread;
+}
+
+void mg_close_after_request(struct mg_connection *conn) {
+  conn->must_close = 1;
+}
+
 int mg_read(struct mg_connection *conn, void *buf, size_t len) {
   int n, buffered_len, nread;
   const char *buffered;
 
+  if (conn->chunked) {
+    return read_chunked(conn, (char *) buf, len);
+  }
+
   assert((conn->content_len == -1 && conn->consumed_content == 0) ||
          conn->consumed_content <= conn->content_len);
   DEBUG_TRACE(("%p %zu %lld %lld", buf, len,
@@ -3661,6 +3772,9 @@ static void reset_per_request_attributes(struct mg_connection *conn) {
 
   conn->num_bytes_sent = conn->consumed_content = 0;
   conn->content_len = -1;
+  conn->chunked = 0;
+  conn->chunk_remaining = 0;
+  conn->must_close = 0;
   conn->request_len = conn->data_len = 0;
 }
 
@@ -3704,7 +3818,11 @@ static void discard_current_request_from_buffer(struct mg_connection *conn) {
   buffered_len = conn->data_len - conn->request_len;
   assert(buffered_len >= 0);
 
-  if (conn->content_len == -1) {
+  if (conn->chunked) {
+    // Only what has been read of the body is known to be part of it
+    body_len = conn->consumed_content < (int64_t) buffered_len ?
+      (int) conn->consumed_content : buffered_len;
+  } else if (conn->content_len == -1) {
     body_len = 0;
   } else if (conn->content_len < (int64_t) buffered_len) {
     body_len = (int) conn->content_len;
@@ -3793,7 +3911,7 @@ static int is_valid_uri(const char *uri) {
 static void process_new_connection(struct mg_connection *conn) {
   struct mg_request_info *ri = &conn->request_info;
   int keep_alive_enabled;
-  const char *cl;
+  const char *cl, *te;
 
   keep_alive_enabled = !strcmp(conn->ctx->config[ENABLE_KEEP_ALIVE], "yes");
 
@@ -3829,6 +3947,12 @@ static void process_new_connection(struct mg_connection *conn) {
       // Request is valid, handle it
       cl = get_header(ri, "Content-Length");
       conn->content_len = cl == NULL ? -1 : strtoll(cl, NULL, 10);
+      te = get_header(ri, "Transfer-Encoding");
+      if (te != NULL && !mg_strcasecmp(te, "chunked")) {
+        // Chunked transfer coding takes precedence over Content-Length
+        conn->chunked = 1;
+        conn->content_len = -1;
+      }
       conn->birth_time = time(NULL);
       if (conn->client.is_proxy) {
         handle_proxy_request(conn);
@@ -3860,14 +3984,14 @@ static int consume_socket(struct mg_context *ctx, struct socket *sp) {
   assert(ctx->sq_head > ctx->sq_tail);
 
   // Copy socket from the queue and increment tail
-  *sp = ctx->queue[ctx->sq_tail % ARRAY_SIZE(ctx->queue)];
+  *sp = ctx->queue[ctx->sq_tail % ctx->queue_size];
   ctx->sq_tail++;
   DEBUG_TRACE(("grabbed socket %d, going busy", sp->sock));
 
   // Wrap pointers if needed
-  while (ctx->sq_tail > (int) ARRAY_SIZE(ctx->queue)) {
-    ctx->sq_tail -= ARRAY_SIZE(ctx->queue);
-    ctx->sq_head -= ARRAY_SIZE(ctx->queue);
+  while (ctx->sq_tail > ctx->queue_size) {
+    ctx->sq_tail -= ctx->queue_size;
+    ctx->sq_head -= ctx->queue_size;
   }
 
   (void) pthread_cond_signal(&ctx->sq_empty);
@@ -3922,13 +4046,13 @@ static void produce_socket(struct mg_context *ctx, const struct socket *sp) {
   (void) pthread_mutex_lock(&ctx->mutex);
 
   // If the queue is full, wait
-  while (ctx->sq_head - ctx->sq_tail >= (int) ARRAY_SIZE(ctx->queue)) {
+  while (ctx->sq_head - ctx->sq_tail >= ctx->queue_size) {
     (void) pthread_cond_wait(&ctx->sq_empty, &ctx->mutex);
   }
-  assert(ctx->sq_head - ctx->sq_tail < (int) ARRAY_SIZE(ctx->queue));
+  assert(ctx->sq_head - ctx->sq_tail < ctx->queue_size);
 
   // Copy socket to the queue and increment head
-  ctx->queue[ctx->sq_head % ARRAY_SIZE(ctx->queue)] = *sp;
+  ctx->queue[ctx->sq_head % ctx->queue_size] = *sp;
   ctx->sq_head++;
   DEBUG_TRACE(("queued socket %d", sp->sock));
 
@@ -4029,6 +4153,11 @@ static void free_context(struct mg_context *ctx) {
       free(ctx->config[i]);
   }
 
+  // Deallocate socket queue
+  if (ctx->queue != NULL) {
+    free(ctx->queue);
+  }
+
   // Deallocate SSL context
   if (ctx->ssl_ctx != NULL) {
     SSL_CTX_free(ctx->ssl_ctx);
@@ -4099,6 +4228,20 @@ struct mg_context *mg_start(mg_callback_t user_callback, void *user_data,
     }
   }
 
+  ctx->queue_size = atoi(ctx->config[SOCKET_QUEUE_SIZE]);
+  if (ctx->queue_size <= 0) {
+    cry(fc(ctx), "Invalid socket queue size: %s",
+        ctx->config[SOCKET_QUEUE_SIZE]);
+    free_context(ctx);
+    return NULL;
+  }
+  ctx->queue = (struct socket *) calloc(ctx->queue_size, sizeof(*ctx->queue));
+  if (ctx->queue == NULL) {
+    cry(fc(ctx), "Cannot allocate socket queue");
+    free_context(ctx);
+    return NULL;
+  }
+
   // NOTE(lsm): order is important here. SSL certificates must
   // be initialized before listening ports. UID must be set last.
   if (!set_gpass_option(ctx) ||
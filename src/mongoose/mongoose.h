@@ -160,6 +160,12 @@ int mg_printf(struct mg_connection *, const char *fmt, ...);
 int mg_read(struct mg_connection *, void *buf, size_t len);
 
 
+// Close the connection once the current request is handled, rather than
+// keeping it alive: needed when the request body was not read to its end,
+// as the rest of it would be taken for the next request.
+void mg_close_after_request(struct mg_connection *);
+
+
 // Get the value of particular HTTP header.
 //
 // This is a helper function. It traverses request_info->http_headers array,
@@ -31,21 +31,27 @@
 #include <QAuthenticator>
 #include <QDateTime>
 #include <QDesktopServices>
-#include <QNetworkDiskCache>
+#include <QNetworkCookie>
 #include <QNetworkRequest>
 #include <QRegExp>
 #include <QSslCertificate>
 #include <QSslCipher>
 #include <QSslKey>
 #include <QSslSocket>
+#include <QTextCodec>
 
 #include "config.h"
 #include "cookiejar.h"
+#include "hostresolver.h"
+#include "memorycache.h"
 #include "networkaccessmanager.h"
 #include "phantom.h"
+#include "requestcoalescer.h"
+#include "requestscheduler.h"
 
 // 10 MB
 const qint64 MAX_REQUEST_POST_BODY_SIZE = 10 * 1000 * 1000;
+const int MAX_SESSION_TICKETS = 1000;
 
 static const char* toString(QNetworkAccessManager::Operation op)
 {
@@ -73,6 +79,47 @@ static const char* toString(QNetworkAccessManager::Operation op)
     return str;
 }
 
+// The body, decoded as UTF-8, goes in "postData"; when it is not text,
+// "postDataBase64" keeps its bytes as well.
+static void addPostData(QVariantMap& data, const QByteArray& body)
+{
+    QTextCodec::ConverterState state;
+    data["postData"] = QTextCodec::codecForMib(106)->toUnicode(body.constData(), body.size(), &state);
+    if (state.invalidChars > 0) {
+        data["postDataBase64"] = QString::fromLatin1(body.toBase64());
+    }
+}
+
+// The protocol the response came over, for HTTP(S) responses which really
+// came from the network: none for those from a cache or the network archive,
+// blocked requests or those failed before any response
+static QString protocolOf(const QNetworkReply* reply)
+{
+    const QString scheme = reply->url().scheme().toLower();
+    if ((scheme != QLatin1String("http") && scheme != QLatin1String("https"))
+        || !reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid()
+        || reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+        return QString();
+    }
+    // Proxies copy the attributes of the reply they stand for
+    const QNetworkReply* source = reply;
+    while (const ProxyReply* proxy = qobject_cast<const ProxyReply*>(source)) {
+        source = proxy->reply();
+        if (!source) {
+            return QString();
+        }
+    }
+    if (qobject_cast<const ArchivedReply*>(source)) {
+        return QString();
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    if (reply->attribute(QNetworkRequest::HTTP2WasUsedAttribute).toBool()) {
+        return QStringLiteral("h2");
+    }
+#endif
+    return QStringLiteral("http/1.1");
+}
+
 // Stub QNetworkReply used when file:/// URLs are disabled.
 // Somewhat cargo-culted from QDisabledNetworkReply.
 
@@ -96,11 +143,26 @@ NoFileAccessReply::NoFileAccessReply(QObject* parent, const QNetworkRequest& req
 // The destructor must be out-of-line in order to trigger generation of the vtable.
 NoFileAccessReply::~NoFileAccessReply() {}
 
-TimeoutTimer::TimeoutTimer(QObject* parent)
-    : QTimer(parent)
+// Stub QNetworkReply for requests blocked by the resource rules: they fail
+// like aborted ones, without ever reaching the network.
+
+BlockedReply::BlockedReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op)
+    : QNetworkReply(parent)
 {
+    setRequest(req);
+    setUrl(req.url());
+    setOperation(op);
+
+    qRegisterMetaType<QNetworkReply::NetworkError>();
+    setError(OperationCanceledError, QLatin1String("Request blocked by resource rules"));
+
+    QMetaObject::invokeMethod(this, "error", Qt::QueuedConnection,
+        Q_ARG(QNetworkReply::NetworkError, OperationCanceledError));
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
 }
 
+BlockedReply::~BlockedReply() {}
+
 JsNetworkRequest::JsNetworkRequest(QNetworkRequest* request, QObject* parent)
     : QObject(parent)
 {
@@ -148,47 +210,14 @@ const ssl_protocol_option ssl_protocol_options[] = {
     { 0, QSsl::UnknownProtocol }
 };
 
-// public:
-NetworkAccessManager::NetworkAccessManager(QObject* parent, const Config* config)
-    : QNetworkAccessManager(parent)
-    , m_ignoreSslErrors(config->ignoreSslErrors())
-    , m_localUrlAccessEnabled(config->localUrlAccessEnabled())
-    , m_authAttempts(0)
-    , m_maxAuthAttempts(3)
-    , m_resourceTimeout(0)
-    , m_idCounter(0)
-    , m_networkDiskCache(Q_NULLPTR)
-    , m_sslConfiguration(QSslConfiguration::defaultConfiguration())
+static QSslConfiguration buildSslConfiguration(const Config* config)
 {
-    if (config->diskCacheEnabled()) {
-        m_networkDiskCache = new QNetworkDiskCache(this);
-
-        if (config->diskCachePath().isEmpty()) {
-            m_networkDiskCache->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
-        } else {
-            m_networkDiskCache->setCacheDirectory(config->diskCachePath());
-        }
-
-        if (config->maxDiskCacheSize() >= 0) {
-            m_networkDiskCache->setMaximumCacheSize(qint64(config->maxDiskCacheSize()) * 1024);
-        }
-        setCache(m_networkDiskCache);
-    }
-
-    if (QSslSocket::supportsSsl()) {
-        prepareSslConfiguration(config);
-    }
-
-    connect(this, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator*)), SLOT(provideAuthentication(QNetworkReply*, QAuthenticator*)));
-    connect(this, SIGNAL(finished(QNetworkReply*)), SLOT(handleFinished(QNetworkReply*)));
-}
-
-void NetworkAccessManager::prepareSslConfiguration(const Config* config)
-{
-    m_sslConfiguration = QSslConfiguration::defaultConfiguration();
+    QSslConfiguration sslConfiguration = QSslConfiguration::defaultConfiguration();
+    // Keep the session tickets, for sessionTickets()
+    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
 
     if (config->ignoreSslErrors()) {
-        m_sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
+        sslConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
     }
 
     bool setProtocol = false;
@@ -196,14 +225,14 @@ void NetworkAccessManager::prepareSslConfiguration(const Config* config)
          proto_opt->name;
          proto_opt++) {
         if (config->sslProtocol() == proto_opt->name) {
-            m_sslConfiguration.setProtocol(proto_opt->proto);
+            sslConfiguration.setProtocol(proto_opt->proto);
             setProtocol = true;
             break;
         }
     }
     // FIXME: actually object to an invalid setting.
     if (!setProtocol) {
-        m_sslConfiguration.setProtocol(QSsl::SecureProtocols);
+        sslConfiguration.setProtocol(QSsl::SecureProtocols);
     }
 
     // Essentially the same as what QSslSocket::setCiphers(QString) does.
@@ -219,7 +248,7 @@ void NetworkAccessManager::prepareSslConfiguration(const Config* config)
             }
         }
         if (!cipherList.isEmpty()) {
-            m_sslConfiguration.setCiphers(cipherList);
+            sslConfiguration.setCiphers(cipherList);
         }
     }
 
@@ -227,7 +256,7 @@ void NetworkAccessManager::prepareSslConfiguration(const Config* config)
         QList<QSslCertificate> caCerts = QSslCertificate::fromPath(
             config->sslCertificatesPath(), QSsl::Pem, QRegExp::Wildcard);
 
-        m_sslConfiguration.setCaCertificates(caCerts);
+        sslConfiguration.setCaCertificates(caCerts);
     }
 
     if (!config->sslClientCertificateFile().isEmpty()) {
@@ -237,26 +266,96 @@ void NetworkAccessManager::prepareSslConfiguration(const Config* config)
         if (!clientCerts.isEmpty()) {
             QSslCertificate clientCert = clientCerts.first();
 
-            QList<QSslCertificate> caCerts = m_sslConfiguration.caCertificates();
+            QList<QSslCertificate> caCerts = sslConfiguration.caCertificates();
             caCerts.append(clientCert);
-            m_sslConfiguration.setCaCertificates(caCerts);
-            m_sslConfiguration.setLocalCertificate(clientCert);
-
-            QFile* keyFile = Q_NULLPTR;
-            if (config->sslClientKeyFile().isEmpty()) {
-                keyFile = new QFile(config->sslClientCertificateFile());
-            } else {
-                keyFile = new QFile(config->sslClientKeyFile());
-            }
+            sslConfiguration.setCaCertificates(caCerts);
+            sslConfiguration.setLocalCertificate(clientCert);
 
-            if (keyFile->open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QSslKey key(keyFile->readAll(), QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, config->sslClientKeyPassphrase());
+            QFile keyFile(config->sslClientKeyFile().isEmpty() ? config->sslClientCertificateFile() : config->sslClientKeyFile());
+            if (keyFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                QSslKey key(keyFile.readAll(), QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, config->sslClientKeyPassphrase());
 
-                m_sslConfiguration.setPrivateKey(key);
-                keyFile->close();
+                sslConfiguration.setPrivateKey(key);
+                keyFile.close();
             }
         }
     }
+
+    return sslConfiguration;
+}
+
+// TLS session tickets by host and port, shared by all the pages so that
+// connecting again to a host resumes the session instead of doing a full handshake
+static QHash<QString, QByteArray>& sessionTickets()
+{
+    static QHash<QString, QByteArray> tickets;
+    return tickets;
+}
+
+static QString sessionTicketKey(const QUrl& url)
+{
+    return url.host().toLower() + QLatin1Char(':') + QString::number(url.port(443));
+}
+
+
+
+// public:
+NetworkAccessManager::NetworkAccessManager(QObject* parent, const Config* config)
+    : QNetworkAccessManager(parent)
+    , m_ignoreSslErrors(config->ignoreSslErrors())
+    , m_localUrlAccessEnabled(config->localUrlAccessEnabled())
+    , m_authAttempts(0)
+    , m_maxAuthAttempts(3)
+    , m_resourceTimeout(0)
+    , m_resourceFirstByteTimeout(0)
+    , m_postDataCaptureSize(0)
+    , m_http2Enabled(false)
+    , m_http2CleartextEnabled(false)
+    , m_idCounter(0)
+    , m_reportedSignals(ReportAllResourceSignals)
+    , m_networkDiskCache(Q_NULLPTR)
+    , m_networkArchive(Phantom::instance()->networkArchive())
+    , m_timeouts(new TimeoutWheel(this))
+    , m_networkIdleMaxInflight(0)
+    , m_networkActive(false)
+    , m_sslConfiguration(QSslConfiguration::defaultConfiguration())
+{
+    if (config->diskCacheEnabled()) {
+        if (config->diskCachePath().isEmpty()) {
+            m_networkDiskCache = new DiskCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation), this);
+        } else {
+            m_networkDiskCache = new DiskCache(config->diskCachePath(), this);
+        }
+
+        if (config->maxDiskCacheSize() >= 0) {
+            m_networkDiskCache->setMaximumCacheSize(qint64(config->maxDiskCacheSize()) * 1024);
+        }
+    }
+
+    if (config->maxMemoryCacheSize() > 0) {
+        // The budget is for the whole process, shared by all the pages
+        MemoryCache::setMaximumCacheSize(qint64(config->maxMemoryCacheSize()) * 1024);
+        setCache(new MemoryCache(m_networkDiskCache, this));
+    } else if (m_networkDiskCache) {
+        setCache(m_networkDiskCache);
+    }
+
+    if (QSslSocket::supportsSsl()) {
+        // Built once for all the pages: loading the certificates and the key is slow
+        static const QSslConfiguration sslConfiguration = buildSslConfiguration(config);
+        m_sslConfiguration = sslConfiguration;
+    }
+
+    m_timingClock.start();
+
+    connect(m_timeouts, SIGNAL(expired(QObject*, int)), SLOT(handleTimeout(QObject*, int)));
+
+    m_networkIdleTimer.setSingleShot(true);
+    m_networkIdleTimer.setInterval(500);
+    connect(&m_networkIdleTimer, SIGNAL(timeout()), SLOT(handleNetworkIdle()));
+
+    connect(this, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator*)), SLOT(provideAuthentication(QNetworkReply*, QAuthenticator*)));
+    connect(this, SIGNAL(finished(QNetworkReply*)), SLOT(handleFinished(QNetworkReply*)));
 }
 
 void NetworkAccessManager::setUserName(const QString& userName)
@@ -274,6 +373,26 @@ void NetworkAccessManager::setResourceTimeout(int resourceTimeout)
     m_resourceTimeout = resourceTimeout;
 }
 
+void NetworkAccessManager::setResourceFirstByteTimeout(int firstByteTimeout)
+{
+    m_resourceFirstByteTimeout = firstByteTimeout;
+}
+
+void NetworkAccessManager::setHttp2Enabled(bool enabled)
+{
+    m_http2Enabled = enabled;
+}
+
+void NetworkAccessManager::setHttp2CleartextEnabled(bool enabled)
+{
+    m_http2CleartextEnabled = enabled;
+}
+
+void NetworkAccessManager::setPostDataCaptureSize(int captureSize)
+{
+    m_postDataCaptureSize = qBound(0, captureSize, int(MAX_REQUEST_POST_BODY_SIZE));
+}
+
 void NetworkAccessManager::setMaxAuthAttempts(int maxAttempts)
 {
     m_maxAuthAttempts = maxAttempts;
@@ -289,6 +408,31 @@ QVariantMap NetworkAccessManager::customHeaders() const
     return m_customHeaders;
 }
 
+void NetworkAccessManager::setResourceRules(const QVariantList& rules)
+{
+    m_resourceRules.setRules(rules);
+}
+
+QVariantList NetworkAccessManager::resourceRules() const
+{
+    return m_resourceRules.rules();
+}
+
+void NetworkAccessManager::setResourcePriorities(const QStringList& resourceTypes)
+{
+    m_resourcePriorities = resourceTypes;
+}
+
+QStringList NetworkAccessManager::resourcePriorities() const
+{
+    return m_resourcePriorities;
+}
+
+void NetworkAccessManager::setReportedSignals(int reportedSignals)
+{
+    m_reportedSignals = reportedSignals;
+}
+
 void NetworkAccessManager::setCookieJar(QNetworkCookieJar* cookieJar)
 {
     QNetworkAccessManager::setCookieJar(cookieJar);
@@ -303,7 +447,23 @@ void NetworkAccessManager::setCookieJar(QNetworkCookieJar* cookieJar)
 // protected:
 QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkRequest& request, QIODevice* outgoingData)
 {
+    const qint64 created = m_timingClock.nsecsElapsed();
     QNetworkRequest req(request);
+
+    // Blocked requests are not reported to the page's handlers at all
+    if (!m_resourceRules.isEmpty()) {
+        QUrl rewrittenUrl;
+        switch (m_resourceRules.match(req, &rewrittenUrl)) {
+        case ResourceRules::Block:
+            return new BlockedReply(this, req, op);
+        case ResourceRules::Rewrite:
+            req.setUrl(rewrittenUrl);
+            break;
+        default:
+            break;
+        }
+    }
+
     QString scheme = req.url().scheme().toLower();
 
     if (!QSslSocket::supportsSsl()) {
@@ -311,25 +471,36 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
             qWarning() << "Request using https scheme without SSL support";
         }
     } else {
-        req.setSslConfiguration(m_sslConfiguration);
+        QSslConfiguration sslConfiguration = m_sslConfiguration;
+        if (scheme == QLatin1String("https")) {
+            const QByteArray ticket = sessionTickets().value(sessionTicketKey(req.url()));
+            if (!ticket.isEmpty()) {
+                sslConfiguration.setSessionTicket(ticket);
+            }
+        }
+        req.setSslConfiguration(sslConfiguration);
     }
 
     // Get the URL string before calling the superclass. Seems to work around
     // segfaults in Qt 4.8: https://gist.github.com/1430393
     QByteArray url = req.url().toEncoded();
-    QByteArray postData;
 
     // http://code.google.com/p/phantomjs/issues/detail?id=337
     if (op == QNetworkAccessManager::PostOperation) {
-        if (outgoingData) {
-            postData = outgoingData->peek(MAX_REQUEST_POST_BODY_SIZE);
-        }
         QString contentType = req.header(QNetworkRequest::ContentTypeHeader).toString();
         if (contentType.isEmpty()) {
             req.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
         }
     }
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    // Negotiated with ALPN over TLS, and by an upgrade from HTTP/1.1 in clear text
+    if ((m_http2Enabled && scheme == QLatin1String("https"))
+        || (m_http2CleartextEnabled && scheme == QLatin1String("http"))) {
+        req.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+    }
+#endif
+
     // set custom HTTP headers
     QVariantMap::const_iterator i = m_customHeaders.begin();
     while (i != m_customHeaders.end()) {
@@ -339,26 +510,37 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
 
     m_idCounter++;
 
-    QVariantList headers;
-    foreach (QByteArray headerName, req.rawHeaderList()) {
-        QVariantMap header;
-        header["name"] = QString::fromUtf8(headerName);
-        header["value"] = QString::fromUtf8(req.rawHeader(headerName));
-        headers += header;
+    // Read now: the body is gone once it is sent
+    QByteArray postData;
+    if (op == QNetworkAccessManager::PostOperation && outgoingData && m_postDataCaptureSize > 0
+        && (m_reportedSignals & (ReportResourceRequested | ReportResourceTimeout))) {
+        postData = outgoingData->peek(m_postDataCaptureSize);
     }
 
     QVariantMap data;
-    data["id"] = m_idCounter;
-    data["url"] = url.data();
-    data["method"] = toString(op);
-    data["headers"] = headers;
-    if (op == QNetworkAccessManager::PostOperation) {
-        data["postData"] = postData.data();
+    if (m_reportedSignals & ReportResourceRequested) {
+        data["id"] = m_idCounter;
+        data["url"] = url.data();
+        data["method"] = toString(op);
+        data["headers"] = getHeadersFromRequest(req);
+        if (!postData.isNull()) {
+            addPostData(data, postData);
+        }
+        data["time"] = QDateTime::currentDateTimeUtc();
     }
-    data["time"] = QDateTime::currentDateTime();
 
     JsNetworkRequest jsNetworkRequest(&req, this);
-    emit resourceRequested(data, &jsNetworkRequest);
+    if (m_reportedSignals & ReportResourceRequested) {
+        emit resourceRequested(data, &jsNetworkRequest);
+    }
+
+    const bool isArchived = m_networkArchive && m_networkArchive->isOpen() && NetworkArchive::isArchived(req);
+    QByteArray archiveKey;
+    if (isArchived) {
+        const bool hasBody = op == QNetworkAccessManager::PostOperation && outgoingData;
+        archiveKey = NetworkArchive::requestKey(toString(op), req.url(),
+            hasBody ? outgoingData->peek(MAX_REQUEST_POST_BODY_SIZE) : QByteArray());
+    }
 
     // file: URLs may be disabled.
     // The second half of this conditional must match
@@ -366,31 +548,86 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
     QNetworkReply* reply;
     if (!m_localUrlAccessEnabled && (req.url().isLocalFile() || scheme == QLatin1String("qrc"))) {
         reply = new NoFileAccessReply(this, req, op);
+    } else if (isArchived && m_networkArchive->mode() == NetworkArchive::Replay) {
+        reply = m_networkArchive->replay(this, req, op, archiveKey, cookieJar());
     } else {
-        reply = QNetworkAccessManager::createRequest(op, req, outgoingData);
+        // Earlier classes of resources go first, here and in Qt's queue of each host
+        const int priority = resourcePriority(req);
+        const int classCount = m_resourcePriorities.size();
+        if (classCount > 0 && priority * 3 < classCount) {
+            req.setPriority(QNetworkRequest::HighPriority);
+        } else if (classCount > 0 && priority * 3 >= classCount * 2) {
+            req.setPriority(QNetworkRequest::LowPriority);
+        }
+
+        RequestCoalescer* coalescer = RequestCoalescer::instance();
+        const QByteArray coalesceKey = coalescer->isEnabled() ? RequestCoalescer::requestKey(req, op, cookieJar()) : QByteArray();
+
+        // Synchronous requests can not wait
+        const bool isNetworkRequest = scheme == QLatin1String("http") || scheme == QLatin1String("https");
+        if (!coalesceKey.isEmpty() && coalescer->isLeading(coalesceKey)) {
+            // Waits for the same request going on, or is started on its own after all
+            ProxyReply* follower = new ProxyReply(this, req, op);
+            QueuedRequest request;
+            request.operation = op;
+            request.request = req;
+            request.outgoingData = outgoingData;
+            request.archiveKey = archiveKey;
+            m_queuedRequests.insert(follower, request);
+            coalescer->join(coalesceKey, follower);
+            reply = follower;
+        } else if (isNetworkRequest && RequestScheduler::instance()->isLimited()
+            && !req.attribute(QNetworkRequest::SynchronousRequestAttribute).toBool()) {
+            ProxyReply* queued = new ProxyReply(this, req, op);
+            QueuedRequest request;
+            request.operation = op;
+            request.request = req;
+            request.outgoingData = outgoingData;
+            request.archiveKey = archiveKey;
+            request.coalesceKey = coalesceKey;
+            m_queuedRequests.insert(queued, request);
+            RequestScheduler::instance()->enqueue(queued, priority);
+            reply = queued;
+        } else {
+            reply = createNetworkReply(op, req, outgoingData, archiveKey, coalesceKey);
+        }
     }
 
     m_ids[reply] = m_idCounter;
 
+    RequestTiming timing;
+    timing.id = m_idCounter;
+    timing.method = toString(op);
+    timing.url = url;
+    timing.status = 0;
+    timing.startedDateTime = QDateTime::currentDateTimeUtc();
+    timing.created = created;
+    timing.started = m_queuedRequests.contains(reply) ? -1 : m_timingClock.nsecsElapsed();
+    timing.encrypted = timing.sent = timing.responseStarted = timing.finished = -1;
+    m_pendingTimings.insert(reply, timing);
+    if (!postData.isNull() && (m_reportedSignals & ReportResourceTimeout)) {
+        m_pendingPostData.insert(reply, postData);
+    }
+
+    m_networkActive = true;
+    updateNetworkIdle();
+
     // reparent jsNetworkRequest to make sure that it will be destroyed with QNetworkReply
     jsNetworkRequest.setParent(reply);
 
-    // If there is a timeout set, create a TimeoutTimer
     if (m_resourceTimeout > 0) {
-
-        TimeoutTimer* nt = new TimeoutTimer(reply);
-        nt->reply = reply; // We need the reply object in order to abort it later on.
-        nt->data = data;
-        nt->setInterval(m_resourceTimeout);
-        nt->setSingleShot(true);
-        nt->start();
-
-        connect(nt, SIGNAL(timeout()), this, SLOT(handleTimeout()));
+        m_timeouts->schedule(reply, TotalTimeout, m_resourceTimeout);
+    }
+    if (m_resourceFirstByteTimeout > 0) {
+        m_timeouts->schedule(reply, FirstByteTimeout, m_resourceFirstByteTimeout);
     }
 
     connect(reply, SIGNAL(readyRead()), this, SLOT(handleStarted()));
     connect(reply, SIGNAL(sslErrors(const QList<QSslError>&)), this, SLOT(handleSslErrors(const QList<QSslError>&)));
     connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(handleNetworkError()));
+    connect(reply, SIGNAL(metaDataChanged()), this, SLOT(handleMetaDataChanged()));
+    connect(reply, SIGNAL(encrypted()), this, SLOT(handleEncrypted()));
+    connect(reply, SIGNAL(uploadProgress(qint64, qint64)), this, SLOT(handleUploadProgress(qint64, qint64)));
 
     // synchronous requests will be finished at this point
     if (reply->isFinished()) {
@@ -401,21 +638,229 @@ QNetworkReply* NetworkAccessManager::createRequest(Operation op, const QNetworkR
     return reply;
 }
 
-void NetworkAccessManager::handleTimeout()
+void NetworkAccessManager::startQueuedRequest(ProxyReply* reply)
 {
-    TimeoutTimer* nt = qobject_cast<TimeoutTimer*>(sender());
+    QHash<QNetworkReply*, QueuedRequest>::iterator it = m_queuedRequests.find(reply);
+    if (it == m_queuedRequests.end()) {
+        return;
+    }
+    const QueuedRequest request = it.value();
+    m_queuedRequests.erase(it);
+
+    QHash<QNetworkReply*, RequestTiming>::iterator timing = m_pendingTimings.find(reply);
+    if (timing != m_pendingTimings.end()) {
+        timing.value().started = m_timingClock.nsecsElapsed();
+    }
+
+    reply->setReply(createNetworkReply(request.operation, request.request, request.outgoingData.data(), request.archiveKey, request.coalesceKey));
+}
 
-    if (!nt->reply) {
+void NetworkAccessManager::restartQueuedRequest(ProxyReply* reply)
+{
+    QHash<QNetworkReply*, QueuedRequest>::const_iterator it = m_queuedRequests.constFind(reply);
+    if (it == m_queuedRequests.constEnd()) {
         return;
     }
 
-    nt->data["errorCode"] = 408;
-    nt->data["errorString"] = "Network timeout on resource.";
+    // Only HTTP(S) requests, never synchronous, are coalesced
+    if (RequestScheduler::instance()->isLimited()) {
+        RequestScheduler::instance()->enqueue(reply, resourcePriority(it.value().request));
+    } else {
+        startQueuedRequest(reply);
+    }
+}
 
-    emit resourceTimeout(nt->data);
+QNetworkReply* NetworkAccessManager::createNetworkReply(Operation op, const QNetworkRequest& req, QIODevice* outgoingData, const QByteArray& archiveKey, const QByteArray& coalesceKey)
+{
+    QNetworkReply* reply;
+    const QUrl resolvedUrl = HostResolver::instance()->resolve(req.url());
+    if (resolvedUrl != req.url()) {
+        // Sent elsewhere, but as if to the host asked for
+        QNetworkRequest resolvedRequest(req);
+        resolvedRequest.setUrl(resolvedUrl);
+        if (!req.hasRawHeader("Host")) {
+            QByteArray host = req.url().host(QUrl::FullyEncoded).toLatin1();
+            if (req.url().port() != -1) {
+                host += ':' + QByteArray::number(req.url().port());
+            }
+            resolvedRequest.setRawHeader("Host", host);
+        }
+
+        resolvedRequest.setAttribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Manual);
+        resolvedRequest.setAttribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Manual);
+        QList<QByteArray> cookies;
+        if (cookieJar() && !req.hasRawHeader("Cookie")) {
+            foreach (const QNetworkCookie& cookie, cookieJar()->cookiesForUrl(req.url())) {
+                cookies += cookie.toRawForm(QNetworkCookie::NameAndValueOnly);
+            }
+        }
+        if (!cookies.isEmpty()) {
+            resolvedRequest.setRawHeader("Cookie", cookies.join("; "));
+        }
+
+        reply = new ResolvedReply(QNetworkAccessManager::createRequest(op, resolvedRequest, outgoingData), req, cookieJar());
+    } else {
+        reply = QNetworkAccessManager::createRequest(op, req, outgoingData);
+    }
+    if (!archiveKey.isEmpty()) {
+        reply = m_networkArchive->record(reply, archiveKey);
+    }
+    if (!coalesceKey.isEmpty()) {
+        reply = RequestCoalescer::instance()->lead(coalesceKey, reply);
+    }
+    return reply;
+}
+
+static double toMilliseconds(qint64 nanoseconds)
+{
+    return nanoseconds / 1000000.0;
+}
+
+QVariantList NetworkAccessManager::networkTimings() const
+{
+    QVariantList entries;
+    foreach (const RequestTiming& timing, m_timings) {
+        // Aborted while queued: blocked all along
+        const qint64 started = timing.started >= 0 ? timing.started : timing.finished;
+        const qint64 connected = timing.encrypted >= 0 ? timing.encrypted : started;
+        const qint64 sent = timing.sent >= 0 ? timing.sent : connected;
+        const qint64 responseStarted = timing.responseStarted >= 0 ? timing.responseStarted : timing.finished;
+
+        QVariantMap timings;
+        timings["blocked"] = toMilliseconds(started - timing.created);
+        timings["dns"] = -1;
+        timings["connect"] = timing.encrypted >= 0 ? toMilliseconds(timing.encrypted - started) : -1;
+        timings["ssl"] = -1;
+        timings["send"] = toMilliseconds(sent - connected);
+        timings["wait"] = toMilliseconds(qMax(responseStarted - sent, qint64(0)));
+        timings["receive"] = toMilliseconds(timing.finished - responseStarted);
+
+        QVariantMap entry;
+        entry["id"] = timing.id;
+        entry["method"] = QString::fromLatin1(timing.method);
+        entry["url"] = QString::fromUtf8(timing.url);
+        entry["status"] = timing.status;
+        if (!timing.protocol.isEmpty()) {
+            entry["protocol"] = timing.protocol;
+        }
+        entry["startedDateTime"] = timing.startedDateTime;
+        entry["time"] = toMilliseconds(timing.finished - timing.created);
+        entry["timings"] = timings;
+        entries += entry;
+    }
+    return entries;
+}
+
+void NetworkAccessManager::clearNetworkTimings()
+{
+    m_timings.clear();
+}
+
+void NetworkAccessManager::setNetworkIdleTime(int quietTime)
+{
+    m_networkIdleTimer.setInterval(qMax(quietTime, 0));
+}
+
+void NetworkAccessManager::setNetworkIdleMaxInflight(int maxInflight)
+{
+    m_networkIdleMaxInflight = qMax(maxInflight, 0);
+}
+
+void NetworkAccessManager::restartNetworkIdle()
+{
+    m_networkActive = true;
+    m_networkIdleTimer.stop();
+    updateNetworkIdle();
+}
+
+int NetworkAccessManager::resourcePriority(const QNetworkRequest& req) const
+{
+    const int index = m_resourcePriorities.indexOf(ResourceRules::resourceType(req));
+    return index < 0 ? m_resourcePriorities.size() : index;
+}
+
+void NetworkAccessManager::updateNetworkIdle()
+{
+    if (m_ids.size() > m_networkIdleMaxInflight) {
+        m_networkIdleTimer.stop();
+    } else if (m_networkActive && !m_networkIdleTimer.isActive()) {
+        m_networkIdleTimer.start();
+    }
+}
+
+void NetworkAccessManager::handleMetaDataChanged()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    m_timeouts->cancel(reply, FirstByteTimeout);
+
+    QHash<QNetworkReply*, RequestTiming>::iterator timing = m_pendingTimings.find(reply);
+    if (timing != m_pendingTimings.end() && timing.value().responseStarted < 0) {
+        timing.value().responseStarted = m_timingClock.nsecsElapsed();
+    }
+}
+
+void NetworkAccessManager::handleEncrypted()
+{
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    QHash<QNetworkReply*, RequestTiming>::iterator timing = m_pendingTimings.find(reply);
+    if (timing != m_pendingTimings.end() && timing.value().encrypted < 0) {
+        timing.value().encrypted = m_timingClock.nsecsElapsed();
+    }
+
+    const QByteArray ticket = reply->sslConfiguration().sessionTicket();
+    if (!ticket.isEmpty()) {
+        QHash<QString, QByteArray>& tickets = sessionTickets();
+        if (tickets.size() >= MAX_SESSION_TICKETS) {
+            tickets.clear();
+        }
+        tickets.insert(sessionTicketKey(reply->url()), ticket);
+    }
+}
+
+void NetworkAccessManager::handleUploadProgress(qint64 bytesSent, qint64 bytesTotal)
+{
+    if (bytesTotal <= 0 || bytesSent < bytesTotal) {
+        return;
+    }
+    QHash<QNetworkReply*, RequestTiming>::iterator timing = m_pendingTimings.find(qobject_cast<QNetworkReply*>(sender()));
+    if (timing != m_pendingTimings.end() && timing.value().sent < 0) {
+        timing.value().sent = m_timingClock.nsecsElapsed();
+    }
+}
+
+void NetworkAccessManager::handleNetworkIdle()
+{
+    m_networkActive = false;
+    emit networkIdle();
+}
+
+void NetworkAccessManager::handleTimeout(QObject* object, int kind)
+{
+    QNetworkReply* reply = static_cast<QNetworkReply*>(object);
+    if (!m_ids.contains(reply)) {
+        return;
+    }
+
+    if (m_reportedSignals & ReportResourceTimeout) {
+        // Only built now: most requests never time out
+        const QNetworkRequest req = reply->request();
+        QVariantMap data;
+        data["id"] = m_ids.value(reply);
+        data["url"] = req.url().toEncoded().data();
+        data["method"] = toString(reply->operation());
+        data["headers"] = getHeadersFromRequest(req);
+        if (m_pendingPostData.contains(reply)) {
+            addPostData(data, m_pendingPostData.value(reply));
+        }
+        data["time"] = m_pendingTimings.value(reply).startedDateTime;
+        data["errorCode"] = 408;
+        data["errorString"] = kind == FirstByteTimeout ? "Network timeout on resource response." : "Network timeout on resource.";
+
+        emit resourceTimeout(data);
+    }
 
     // Abort the reply that we attached to the Network Timeout
-    nt->reply->abort();
+    reply->abort();
 }
 
 void NetworkAccessManager::handleStarted()
@@ -424,13 +869,14 @@ void NetworkAccessManager::handleStarted()
     if (!reply) {
         return;
     }
-    if (m_started.contains(reply)) {
+    if (!(m_reportedSignals & ReportResourceReceived) || m_started.contains(reply)) {
         return;
     }
 
     m_started += reply;
 
     QVariantList headers = getHeadersFromReply(reply);
+    m_replyHeaders.insert(reply, headers);
 
     QVariantMap data;
     data["stage"] = "start";
@@ -442,7 +888,11 @@ void NetworkAccessManager::handleStarted()
     data["bodySize"] = reply->size();
     data["redirectURL"] = reply->header(QNetworkRequest::LocationHeader);
     data["headers"] = headers;
-    data["time"] = QDateTime::currentDateTime();
+    const QString protocol = protocolOf(reply);
+    if (!protocol.isEmpty()) {
+        data["protocol"] = protocol;
+    }
+    data["time"] = QDateTime::currentDateTimeUtc();
     data["body"] = "";
 
     emit resourceReceived(data);
@@ -467,29 +917,62 @@ void NetworkAccessManager::provideAuthentication(QNetworkReply* reply, QAuthenti
         authenticator->setPassword(m_password);
     } else {
         m_authAttempts = 0;
-        this->handleFinished(reply, 401, "Authorization Required");
+        // Qt asks for the reply it made, which may stand behind the one given to the page
+        QNetworkReply* tracked = reply;
+        while (tracked && !m_ids.contains(tracked)) {
+            tracked = qobject_cast<QNetworkReply*>(tracked->parent());
+        }
+        if (tracked) {
+            this->handleFinished(tracked, 401, "Authorization Required");
+        }
         reply->close();
     }
 }
 
 void NetworkAccessManager::handleFinished(QNetworkReply* reply, const QVariant& status, const QVariant& statusText)
 {
-    QVariantList headers = getHeadersFromReply(reply);
+    const int id = m_ids.take(reply);
+    QVariantList headers = m_replyHeaders.take(reply);
+    m_started.remove(reply);
+    m_queuedRequests.remove(reply);
+    m_pendingPostData.remove(reply);
+    m_timeouts->cancel(reply, TotalTimeout);
+    m_timeouts->cancel(reply, FirstByteTimeout);
+    reply->deleteLater();
+
+    QHash<QNetworkReply*, RequestTiming>::iterator timing = m_pendingTimings.find(reply);
+    if (timing != m_pendingTimings.end()) {
+        timing.value().finished = m_timingClock.nsecsElapsed();
+        timing.value().status = status.toInt();
+        timing.value().protocol = protocolOf(reply);
+        m_timings += timing.value();
+        m_pendingTimings.erase(timing);
+    }
+
+    updateNetworkIdle();
+
+    if (!(m_reportedSignals & ReportResourceReceived)) {
+        return;
+    }
+
+    if (headers.isEmpty()) {
+        headers = getHeadersFromReply(reply);
+    }
 
     QVariantMap data;
     data["stage"] = "end";
-    data["id"] = m_ids.value(reply);
+    data["id"] = id;
     data["url"] = reply->url().toEncoded().data();
     data["status"] = status;
     data["statusText"] = statusText;
     data["contentType"] = reply->header(QNetworkRequest::ContentTypeHeader);
     data["redirectURL"] = reply->header(QNetworkRequest::LocationHeader);
     data["headers"] = headers;
-    data["time"] = QDateTime::currentDateTime();
-
-    m_ids.remove(reply);
-    m_started.remove(reply);
-    reply->deleteLater();
+    const QString protocol = protocolOf(reply);
+    if (!protocol.isEmpty()) {
+        data["protocol"] = protocol;
+    }
+    data["time"] = QDateTime::currentDateTimeUtc();
 
     emit resourceReceived(data);
 }
@@ -514,6 +997,10 @@ void NetworkAccessManager::handleNetworkError()
              << "(" << reply->errorString() << ")"
              << "URL:" << reply->url().toEncoded();
 
+    if (!(m_reportedSignals & ReportResourceError)) {
+        return;
+    }
+
     QVariantMap data;
     data["id"] = m_ids.value(reply);
     data["url"] = reply->url().toEncoded().data();
@@ -525,13 +1012,26 @@ void NetworkAccessManager::handleNetworkError()
     emit resourceError(data);
 }
 
-QVariantList NetworkAccessManager::getHeadersFromReply(const QNetworkReply* reply)
+QVariantList NetworkAccessManager::getHeadersFromRequest(const QNetworkRequest& req)
 {
     QVariantList headers;
-    foreach (QByteArray headerName, reply->rawHeaderList()) {
+    foreach (QByteArray headerName, req.rawHeaderList()) {
         QVariantMap header;
         header["name"] = QString::fromUtf8(headerName);
-        header["value"] = QString::fromUtf8(reply->rawHeader(headerName));
+        header["value"] = QString::fromUtf8(req.rawHeader(headerName));
+        headers += header;
+    }
+    return headers;
+}
+
+QVariantList NetworkAccessManager::getHeadersFromReply(const QNetworkReply* reply)
+{
+    QVariantList headers;
+    // The pairs spare a lookup of each header by name
+    foreach (const QNetworkReply::RawHeaderPair& pair, reply->rawHeaderPairs()) {
+        QVariantMap header;
+        header["name"] = QString::fromUtf8(pair.first);
+        header["value"] = QString::fromUtf8(pair.second);
         headers += header;
     }
 
@@ -31,26 +31,26 @@
 #ifndef NETWORKACCESSMANAGER_H
 #define NETWORKACCESSMANAGER_H
 
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QPointer>
 #include <QSslConfiguration>
 #include <QStringList>
 #include <QTimer>
+#include <QVector>
+
+#include "diskcache.h"
+#include "networkarchive.h"
+#include "proxyreply.h"
+#include "resourcerules.h"
+#include "timeoutwheel.h"
 
 class Config;
 class QAuthenticator;
-class QNetworkDiskCache;
 class QSslConfiguration;
 
-class TimeoutTimer : public QTimer {
-    Q_OBJECT
-
-public:
-    TimeoutTimer(QObject* parent = 0);
-    QNetworkReply* reply;
-    QVariantMap data;
-};
-
 class JsNetworkRequest : public QObject {
     Q_OBJECT
 
@@ -76,27 +76,107 @@ protected:
     qint64 readData(char*, qint64) { return -1; }
 };
 
+class BlockedReply : public QNetworkReply {
+    Q_OBJECT
+
+public:
+    BlockedReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op);
+    ~BlockedReply();
+    void abort() {}
+
+protected:
+    qint64 readData(char*, qint64) { return -1; }
+};
+
 class NetworkAccessManager : public QNetworkAccessManager {
     Q_OBJECT
 public:
+    enum ReportedSignal {
+        ReportResourceRequested = 0x1,
+        ReportResourceReceived = 0x2,
+        ReportResourceError = 0x4,
+        ReportResourceTimeout = 0x8,
+        ReportAllResourceSignals = 0xf
+    };
+
     NetworkAccessManager(QObject* parent, const Config* config);
     void setUserName(const QString& userName);
     void setPassword(const QString& password);
     void setMaxAuthAttempts(int maxAttempts);
     void setResourceTimeout(int resourceTimeout);
+    // Time to wait for the response headers, 0 for no limit but resourceTimeout
+    void setResourceFirstByteTimeout(int firstByteTimeout);
+    /**
+     * Let HTTPS requests, and plain HTTP ones, go over HTTP/2 where the
+     * server has it. Needs Qt 5.8; with an older Qt, requests use HTTP/1.1.
+     */
+    void setHttp2Enabled(bool enabled);
+    void setHttp2CleartextEnabled(bool enabled);
+    // Bytes of POST bodies reported as "postData", 0 not to read them at all
+    void setPostDataCaptureSize(int captureSize);
     void setCustomHeaders(const QVariantMap& headers);
     QVariantMap customHeaders() const;
     QStringList captureContent() const;
     void setCaptureContent(const QStringList& patterns);
+    void setResourceRules(const QVariantList& rules);
+    QVariantList resourceRules() const;
+
+    /**
+     * Resource types, as in ResourceRules::resourceType, from the first
+     * to start to the last; those not listed come after them all.
+     */
+    void setResourcePriorities(const QStringList& resourceTypes);
+    QStringList resourcePriorities() const;
+
+    /**
+     * Start a request the RequestScheduler held back until now.
+     */
+    void startQueuedRequest(ProxyReply* reply);
+
+    /**
+     * Start a request the RequestCoalescer held back, once the
+     * RequestScheduler lets it.
+     */
+    void restartQueuedRequest(ProxyReply* reply);
+
+    /**
+     * Timings of the requests finished since the last clearNetworkTimings(),
+     * as entries shaped like those of HAR: "startedDateTime", "time" and
+     * "timings" with "blocked", "dns", "connect", "ssl", "send", "wait"
+     * and "receive", in milliseconds, measured on a monotonic clock.
+     *
+     * NOTE: Qt does not tell when name resolution and connecting end, so
+     * "dns" and "ssl" are always -1 and "connect" is only known for HTTPS
+     * requests opening a connection, as the time until it is encrypted.
+     */
+    QVariantList networkTimings() const;
+    void clearNetworkTimings();
+
+    /**
+     * networkIdle() is emitted once no more than maxInflight requests
+     * have been in flight for quietTime milliseconds (500 and 0 by default).
+     * It is emitted once per burst of activity; restartNetworkIdle()
+     * starts waiting for it again even without new requests.
+     */
+    void setNetworkIdleTime(int quietTime);
+    void setNetworkIdleMaxInflight(int maxInflight);
+    void restartNetworkIdle();
 
     void setCookieJar(QNetworkCookieJar* cookieJar);
 
+    // Resource signals left out are not emitted, sparing the building of their data
+    void setReportedSignals(int reportedSignals);
+
 protected:
     bool m_ignoreSslErrors;
     bool m_localUrlAccessEnabled;
     int m_authAttempts;
     int m_maxAuthAttempts;
     int m_resourceTimeout;
+    int m_resourceFirstByteTimeout;
+    int m_postDataCaptureSize;
+    bool m_http2Enabled;
+    bool m_http2CleartextEnabled;
     QString m_userName;
     QString m_password;
     QNetworkReply* createRequest(Operation op, const QNetworkRequest& req, QIODevice* outgoingData = 0);
@@ -107,6 +187,7 @@ signals:
     void resourceReceived(const QVariant& data);
     void resourceError(const QVariant& data);
     void resourceTimeout(const QVariant& data);
+    void networkIdle();
 
 private slots:
     void handleStarted();
@@ -114,17 +195,72 @@ private slots:
     void provideAuthentication(QNetworkReply* reply, QAuthenticator* authenticator);
     void handleSslErrors(const QList<QSslError>& errors);
     void handleNetworkError();
-    void handleTimeout();
+    void handleTimeout(QObject* reply, int kind);
+    void handleMetaDataChanged();
+    void handleEncrypted();
+    void handleUploadProgress(qint64 bytesSent, qint64 bytesTotal);
+    void handleNetworkIdle();
 
 private:
-    void prepareSslConfiguration(const Config* config);
+    QVariantList getHeadersFromRequest(const QNetworkRequest& req);
     QVariantList getHeadersFromReply(const QNetworkReply* reply);
+    QNetworkReply* createNetworkReply(Operation op, const QNetworkRequest& req, QIODevice* outgoingData, const QByteArray& archiveKey, const QByteArray& coalesceKey);
+    int resourcePriority(const QNetworkRequest& req) const;
+    void updateNetworkIdle();
+
+    enum TimeoutKind {
+        TotalTimeout,
+        FirstByteTimeout
+    };
+
+    // Times are in nanoseconds on m_timingClock, -1 until they happen
+    struct RequestTiming {
+        int id;
+        QByteArray method;
+        QByteArray url;
+        int status;
+        QString protocol;
+        QDateTime startedDateTime;
+        qint64 created;
+        qint64 started;
+        qint64 encrypted;
+        qint64 sent;
+        qint64 responseStarted;
+        qint64 finished;
+    };
+
+    struct QueuedRequest {
+        Operation operation;
+        QNetworkRequest request;
+        QPointer<QIODevice> outgoingData;
+        QByteArray archiveKey;
+        QByteArray coalesceKey;
+    };
 
     QHash<QNetworkReply*, int> m_ids;
     QSet<QNetworkReply*> m_started;
+    // Reported when the reply starts, sent again when it finishes
+    QHash<QNetworkReply*, QVariantList> m_replyHeaders;
     int m_idCounter;
-    QNetworkDiskCache* m_networkDiskCache;
+    int m_reportedSignals;
+    DiskCache* m_networkDiskCache;
+    NetworkArchive* m_networkArchive;
     QVariantMap m_customHeaders;
+    ResourceRules m_resourceRules;
+    QStringList m_resourcePriorities;
+    // Requests waiting for the RequestScheduler, by the reply standing for them
+    QHash<QNetworkReply*, QueuedRequest> m_queuedRequests;
+    QElapsedTimer m_timingClock;
+    QHash<QNetworkReply*, RequestTiming> m_pendingTimings;
+    QVector<RequestTiming> m_timings;
+    // Start of the POST bodies, for onResourceTimeout
+    QHash<QNetworkReply*, QByteArray> m_pendingPostData;
+    // Resource timeouts of all the requests going on
+    TimeoutWheel* m_timeouts;
+    QTimer m_networkIdleTimer;
+    int m_networkIdleMaxInflight;
+    // Requests were made since networkIdle() was last emitted
+    bool m_networkActive;
     QSslConfiguration m_sslConfiguration;
 };
 
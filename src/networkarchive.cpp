@@ -0,0 +1,362 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "networkarchive.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QNetworkCookie>
+
+#include <cstring>
+
+static const QByteArray ARCHIVE_MAGIC("PJSNETA1");
+static const QByteArray INDEX_MAGIC("PJSNETI1");
+
+// Headers describing the transfer rather than the content, which replies
+// from the archive set again for the decoded body
+static bool isTransferHeader(const QByteArray& name)
+{
+    const QByteArray lowerName = name.toLower();
+    return lowerName == "content-length" || lowerName == "content-encoding" || lowerName == "transfer-encoding";
+}
+
+// public:
+NetworkArchive::NetworkArchive(const QString& fileName, Mode mode, QObject* parent)
+    : QObject(parent)
+    , m_file(fileName)
+    , m_mode(mode)
+{
+    if (m_mode == Record) {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "NetworkArchive - Unable to create" << fileName << ":" << m_file.errorString();
+            return;
+        }
+        m_file.write(ARCHIVE_MAGIC);
+        qDebug() << "NetworkArchive - Recording to" << fileName;
+        return;
+    }
+
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.read(ARCHIVE_MAGIC.size()) != ARCHIVE_MAGIC) {
+        qWarning() << "NetworkArchive - Unable to open" << fileName << "as an archive";
+        m_file.close();
+        return;
+    }
+    if (!readIndex()) {
+        qWarning() << "NetworkArchive - No index in" << fileName << ", going over its records";
+        buildIndex();
+    }
+    qDebug() << "NetworkArchive - Replaying" << m_index.size() << "requests from" << fileName;
+}
+
+NetworkArchive::~NetworkArchive()
+{
+    if (m_mode == Record && m_file.isOpen()) {
+        writeIndex();
+    }
+}
+
+NetworkArchive::Mode NetworkArchive::mode() const
+{
+    return m_mode;
+}
+
+bool NetworkArchive::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool NetworkArchive::isArchived(const QNetworkRequest& request)
+{
+    const QString scheme = request.url().scheme().toLower();
+    return scheme == QLatin1String("http") || scheme == QLatin1String("https");
+}
+
+QByteArray NetworkArchive::requestKey(const QByteArray& method, const QUrl& url, const QByteArray& body)
+{
+    QByteArray key = method + ' ' + url.adjusted(QUrl::RemoveFragment).toEncoded();
+    if (!body.isEmpty()) {
+        key += ' ' + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex();
+    }
+    return key;
+}
+
+NetworkArchive::Response NetworkArchive::response(const QNetworkReply* reply, const QByteArray& body)
+{
+    Response response;
+    response.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    response.reasonPhrase = reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+    foreach (const QNetworkReply::RawHeaderPair& header, reply->rawHeaderPairs()) {
+        if (!isTransferHeader(header.first)) {
+            response.headers += header;
+        }
+    }
+    response.error = reply->error();
+    response.errorString = reply->errorString();
+    response.body = body;
+    return response;
+}
+
+QNetworkReply* NetworkArchive::record(QNetworkReply* reply, const QByteArray& key)
+{
+    return new RecordingReply(reply, this, key);
+}
+
+QNetworkReply* NetworkArchive::replay(QObject* parent, const QNetworkRequest& request, QNetworkAccessManager::Operation op, const QByteArray& key, QNetworkCookieJar* cookieJar)
+{
+    Response response;
+    QByteArray recordedKey;
+    QHash<QByteArray, QList<qint64> >::const_iterator it = m_index.constFind(key);
+    // Once all the responses were served, the last one is served again
+    if (it == m_index.constEnd() || !read(it.value().at(qMin(m_replayed.value(key), it.value().size() - 1)), &recordedKey, &response)) {
+        qDebug() << "NetworkArchive - Not in the archive:" << key;
+        response.status = 0;
+        response.error = QNetworkReply::ContentNotFoundError;
+        response.errorString = QLatin1String("Not in the network archive");
+        response.headers.clear();
+        response.body.clear();
+    } else {
+        ++m_replayed[key];
+    }
+    return new ArchivedReply(parent, request, op, response, cookieJar);
+}
+
+void NetworkArchive::write(const QByteArray& key, const Response& response)
+{
+    if (m_mode != Record || !m_file.isOpen()) {
+        return;
+    }
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << key << qint32(response.status) << response.reasonPhrase << response.headers;
+    out << qint32(response.error) << response.errorString << qCompress(response.body);
+
+    const qint64 offset = m_file.pos();
+    QDataStream file(&m_file);
+    file << quint32(record.size());
+    m_file.write(record);
+    // A crash loses at most the record being written
+    m_file.flush();
+    m_index[key] += offset;
+}
+
+// private:
+bool NetworkArchive::read(qint64 offset, QByteArray* key, Response* response)
+{
+    if (!m_file.seek(offset)) {
+        return false;
+    }
+    QDataStream file(&m_file);
+    quint32 size;
+    file >> size;
+    const QByteArray record = m_file.read(size);
+    if (file.status() != QDataStream::Ok || record.size() != int(size)) {
+        return false;
+    }
+
+    QDataStream in(record);
+    in.setVersion(QDataStream::Qt_5_0);
+    qint32 status;
+    qint32 error;
+    QByteArray body;
+    in >> *key >> status >> response->reasonPhrase >> response->headers;
+    in >> error >> response->errorString >> body;
+    response->status = status;
+    response->error = error;
+    response->body = qUncompress(body);
+    return in.status() == QDataStream::Ok;
+}
+
+bool NetworkArchive::readIndex()
+{
+    const qint64 size = m_file.size();
+    if (size < ARCHIVE_MAGIC.size() + 8 + INDEX_MAGIC.size()) {
+        return false;
+    }
+    m_file.seek(size - INDEX_MAGIC.size());
+    if (m_file.read(INDEX_MAGIC.size()) != INDEX_MAGIC) {
+        return false;
+    }
+
+    m_file.seek(size - INDEX_MAGIC.size() - 8);
+    QDataStream in(&m_file);
+    in.setVersion(QDataStream::Qt_5_0);
+    qint64 indexOffset;
+    in >> indexOffset;
+    if (!m_file.seek(indexOffset)) {
+        return false;
+    }
+    in >> m_index;
+    return in.status() == QDataStream::Ok;
+}
+
+void NetworkArchive::buildIndex()
+{
+    m_index.clear();
+    qint64 offset = ARCHIVE_MAGIC.size();
+    QByteArray key;
+    Response response;
+    while (offset < m_file.size() && read(offset, &key, &response)) {
+        m_index[key] += offset;
+        offset = m_file.pos();
+    }
+}
+
+void NetworkArchive::writeIndex()
+{
+    const qint64 indexOffset = m_file.pos();
+    QDataStream out(&m_file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << m_index << indexOffset;
+    m_file.write(INDEX_MAGIC);
+    m_file.close();
+}
+
+// Recording
+
+RecordingReply::RecordingReply(QNetworkReply* reply, NetworkArchive* archive, const QByteArray& key)
+    : ProxyReply(reply->parent(), reply->request(), reply->operation())
+    , m_archive(archive)
+    , m_key(key)
+{
+    setReply(reply);
+}
+
+// protected:
+void RecordingReply::bodyReceived(const QByteArray& data)
+{
+    m_body += data;
+}
+
+void RecordingReply::replyFinished()
+{
+    // Aborted requests tell nothing about the server
+    if (!m_archive || error() == OperationCanceledError) {
+        return;
+    }
+
+    m_archive->write(m_key, NetworkArchive::response(this, m_body));
+}
+
+// Replaying
+
+ArchivedReply::ArchivedReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op, const NetworkArchive::Response& response, QNetworkCookieJar* cookieJar)
+    : QNetworkReply(parent)
+    , m_body(response.body)
+    , m_readOffset(0)
+{
+    setRequest(req);
+    setUrl(req.url());
+    setOperation(op);
+
+    if (response.status > 0) {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, response.status);
+        setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, response.reasonPhrase);
+        foreach (const RawHeaderPair& header, response.headers) {
+            setRawHeader(header.first, header.second);
+        }
+        setHeader(QNetworkRequest::ContentLengthHeader, m_body.size());
+
+        const QByteArray location = rawHeader("Location");
+        if (response.status >= 300 && response.status < 400 && !location.isEmpty()) {
+            setAttribute(QNetworkRequest::RedirectionTargetAttribute, QUrl::fromEncoded(location));
+        }
+
+        // Before the page sees the response, as for the replies of Qt
+        const QList<QNetworkCookie> cookies = QNetworkCookie::parseCookies(rawHeader("Set-Cookie"));
+        if (cookieJar && !cookies.isEmpty()
+            && req.attribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Automatic).toInt() == QNetworkRequest::Automatic) {
+            cookieJar->setCookiesFromUrl(cookies, req.url());
+        }
+    }
+
+    qRegisterMetaType<QNetworkReply::NetworkError>();
+    if (response.error != NoError) {
+        setError(NetworkError(response.error), response.errorString);
+    }
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    // Synchronous requests expect the reply to be over on return
+    if (req.attribute(QNetworkRequest::SynchronousRequestAttribute).toBool()) {
+        setFinished(true);
+    } else {
+        QMetaObject::invokeMethod(this, "emitResponse", Qt::QueuedConnection);
+    }
+}
+
+void ArchivedReply::abort()
+{
+    if (isFinished()) {
+        return;
+    }
+    setError(OperationCanceledError, QLatin1String("Operation canceled"));
+    setFinished(true);
+    emit error(OperationCanceledError);
+    emit finished();
+}
+
+qint64 ArchivedReply::bytesAvailable() const
+{
+    return m_body.size() - m_readOffset + QNetworkReply::bytesAvailable();
+}
+
+// protected:
+qint64 ArchivedReply::readData(char* data, qint64 maxSize)
+{
+    const qint64 size = qMin(maxSize, m_body.size() - m_readOffset);
+    if (size <= 0) {
+        return isFinished() ? -1 : 0;
+    }
+    memcpy(data, m_body.constData() + m_readOffset, size);
+    m_readOffset += size;
+    return size;
+}
+
+// private slots:
+void ArchivedReply::emitResponse()
+{
+    // Aborted meanwhile
+    if (isFinished()) {
+        return;
+    }
+
+    emit metaDataChanged();
+    if (!m_body.isEmpty()) {
+        emit readyRead();
+    }
+    emit downloadProgress(m_body.size(), m_body.size());
+    if (error() != NoError) {
+        emit error(error());
+    }
+    setFinished(true);
+    emit finished();
+}
@@ -0,0 +1,170 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef NETWORKARCHIVE_H
+#define NETWORKARCHIVE_H
+
+#include <QFile>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkCookieJar>
+#include <QNetworkReply>
+#include <QPointer>
+
+#include "proxyreply.h"
+
+/**
+ * Archive of network responses, to record a session once and replay it
+ * afterwards without the network.
+ *
+ * In record mode, every HTTP(S) response, headers and body, is appended
+ * to the file as it completes; closing the archive appends an index of
+ * the records by request. In replay mode, responses come from the archive
+ * alone: requests it has no record of fail. Requests are told apart by
+ * method, URL and, for POST, body; one recorded several times is answered
+ * with its responses in the order they were recorded.
+ *
+ * The file starts with a magic number, then has one record per response:
+ * its length, then the request key, status, headers and the zlib
+ * compressed body, in a QDataStream. The index and its offset follow,
+ * and the file ends with a second magic number. An archive left without
+ * an index, by a crash, is indexed again by going over its records.
+ */
+class NetworkArchive : public QObject {
+    Q_OBJECT
+
+public:
+    enum Mode {
+        Record,
+        Replay
+    };
+
+    struct Response {
+        int status;
+        QByteArray reasonPhrase;
+        QList<QNetworkReply::RawHeaderPair> headers;
+        int error;
+        QString errorString;
+        QByteArray body;
+    };
+
+    NetworkArchive(const QString& fileName, Mode mode, QObject* parent = Q_NULLPTR);
+    virtual ~NetworkArchive();
+
+    Mode mode() const;
+    bool isOpen() const;
+
+    /**
+     * Only HTTP and HTTPS requests go to and from the archive.
+     */
+    static bool isArchived(const QNetworkRequest& request);
+    static QByteArray requestKey(const QByteArray& method, const QUrl& url, const QByteArray& body);
+
+    /**
+     * The response of a finished reply, whose body, decoded, was this;
+     * headers about the transfer of the body are left out.
+     */
+    static Response response(const QNetworkReply* reply, const QByteArray& body);
+
+    /**
+     * Record mode: the reply to hand out instead of this one, which it
+     * takes over, so that the response is recorded as it goes by.
+     */
+    QNetworkReply* record(QNetworkReply* reply, const QByteArray& key);
+
+    /**
+     * Replay mode: a reply with the next recorded response to the request.
+     * @param cookieJar gets the cookies the response sets
+     */
+    QNetworkReply* replay(QObject* parent, const QNetworkRequest& request, QNetworkAccessManager::Operation op, const QByteArray& key, QNetworkCookieJar* cookieJar);
+
+    void write(const QByteArray& key, const Response& response);
+
+private:
+    bool read(qint64 offset, QByteArray* key, Response* response);
+    bool readIndex();
+    void buildIndex();
+    void writeIndex();
+
+    QFile m_file;
+    Mode m_mode;
+    // Offsets of the records, by request key, in recorded order
+    QHash<QByteArray, QList<qint64> > m_index;
+    // Replay mode: the responses already served, by request key
+    QHash<QByteArray, int> m_replayed;
+};
+
+/**
+ * Reply forwarding another one, while keeping what goes through for the
+ * archive.
+ */
+class RecordingReply : public ProxyReply {
+    Q_OBJECT
+
+public:
+    RecordingReply(QNetworkReply* reply, NetworkArchive* archive, const QByteArray& key);
+
+protected:
+    void bodyReceived(const QByteArray& data);
+    void replyFinished();
+
+private:
+    QPointer<NetworkArchive> m_archive;
+    QByteArray m_key;
+    QByteArray m_body;
+};
+
+/**
+ * Synthetic reply serving a response from the archive.
+ *
+ * Qt only keeps the cookies of the replies it makes itself: this one
+ * puts those its response sets in the cookie jar, as the request allows.
+ */
+class ArchivedReply : public QNetworkReply {
+    Q_OBJECT
+
+public:
+    ArchivedReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op, const NetworkArchive::Response& response, QNetworkCookieJar* cookieJar);
+
+    void abort();
+    qint64 bytesAvailable() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize);
+
+private slots:
+    void emitResponse();
+
+private:
+    QByteArray m_body;
+    qint64 m_readOffset;
+};
+
+#endif // NETWORKARCHIVE_H
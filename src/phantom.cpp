@@ -46,7 +46,13 @@
 #include "childprocess.h"
 #include "consts.h"
 #include "cookiejar.h"
+#include "diskcache.h"
+#include "hostresolver.h"
+#include "memorycache.h"
+#include "networkarchive.h"
 #include "repl.h"
+#include "requestcoalescer.h"
+#include "requestscheduler.h"
 #include "system.h"
 #include "terminal.h"
 #include "utils.h"
@@ -67,6 +73,8 @@ Phantom::Phantom(QObject* parent)
     , m_filesystem(0)
     , m_system(0)
     , m_childprocess(0)
+    , m_defaultCookieJar(0)
+    , m_networkArchive(0)
 {
     QStringList args = QApplication::arguments();
 
@@ -106,6 +114,29 @@ void Phantom::init()
     // Initialize the CookieJar
     m_defaultCookieJar = new CookieJar(m_config.cookiesFile());
 
+    // Set up the network archive, before any page needs it; deleting it
+    // with this object writes the index of a recorded one
+    if (!m_config.networkArchive().isEmpty()) {
+        m_networkArchive = new NetworkArchive(m_config.networkArchive(),
+            m_config.networkArchiveMode() == "record" ? NetworkArchive::Record : NetworkArchive::Replay, this);
+    }
+
+    RequestScheduler::instance()->setLimits(m_config.maxConnections(), m_config.maxConnectionsPerHost());
+    RequestCoalescer::instance()->setEnabled(m_config.coalesceRequests());
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 8, 0)
+    if (m_config.http2Enabled() || m_config.http2CleartextEnabled()) {
+        qWarning() << "HTTP/2 needs Qt 5.8 or later: requests use HTTP/1.1";
+    }
+#endif
+
+    HostResolver* hostResolver = HostResolver::instance();
+    if (!hostResolver->setRules(m_config.hostResolverRules())) {
+        qWarning() << "Invalid host resolver rules:" << m_config.hostResolverRules();
+    }
+    hostResolver->setCacheTtl(m_config.dnsCacheTtl());
+    hostResolver->prefetch(m_config.dnsPrefetch().split(QLatin1Char(','), QString::SkipEmptyParts));
+
     // set the default DPI
     m_defaultDpi = qRound(QApplication::primaryScreen()->logicalDotsPerInch());
 
@@ -149,6 +180,14 @@ void Phantom::init()
     m_defaultPageSettings[PAGE_SETTINGS_JS_CAN_OPEN_WINDOWS] = QVariant::fromValue(m_config.javascriptCanOpenWindows());
     m_defaultPageSettings[PAGE_SETTINGS_JS_CAN_CLOSE_WINDOWS] = QVariant::fromValue(m_config.javascriptCanCloseWindows());
     m_defaultPageSettings[PAGE_SETTINGS_DPI] = QVariant::fromValue(m_defaultDpi);
+    // Requests from XMLHttpRequest can not be told apart: they are "other"
+    m_defaultPageSettings[PAGE_SETTINGS_RESOURCE_PRIORITIES] = QStringList()
+        << "document" << "stylesheet" << "script" << "image" << "font" << "other";
+    m_defaultPageSettings[PAGE_SETTINGS_NETWORK_IDLE_TIME] = QVariant::fromValue(500);
+    m_defaultPageSettings[PAGE_SETTINGS_NETWORK_IDLE_MAX_INFLIGHT] = QVariant::fromValue(0);
+    m_defaultPageSettings[PAGE_SETTINGS_POST_DATA_CAPTURE_SIZE] = QVariant::fromValue(0);
+    m_defaultPageSettings[PAGE_SETTINGS_HTTP2_ENABLED] = QVariant::fromValue(m_config.http2Enabled());
+    m_defaultPageSettings[PAGE_SETTINGS_HTTP2_CLEARTEXT_ENABLED] = QVariant::fromValue(m_config.http2CleartextEnabled());
     m_page->applySettings(m_defaultPageSettings);
 
     setLibraryPath(QFileInfo(m_config.scriptFile()).dir().absolutePath());
@@ -270,6 +309,11 @@ Config* Phantom::config()
     return &m_config;
 }
 
+NetworkArchive* Phantom::networkArchive() const
+{
+    return m_networkArchive;
+}
+
 bool Phantom::printDebugMessages() const
 {
     return m_config.printDebugMessages();
@@ -415,6 +459,26 @@ int Phantom::remoteDebugPort() const
     return m_config.remoteDebugPort();
 }
 
+QVariantMap Phantom::diskCacheStats() const
+{
+    return DiskCache::stats();
+}
+
+QVariantMap Phantom::memoryCacheStats() const
+{
+    return MemoryCache::stats();
+}
+
+QVariantMap Phantom::requestCoalescerStats() const
+{
+    return RequestCoalescer::instance()->stats();
+}
+
+QVariantMap Phantom::hostResolverStats() const
+{
+    return HostResolver::instance()->stats();
+}
+
 void Phantom::exit(int code)
 {
     if (m_config.debug()) {
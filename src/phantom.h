@@ -40,6 +40,7 @@
 #include "filesystem.h"
 #include "system.h"
 
+class NetworkArchive;
 class WebPage;
 class CustomPage;
 class WebServer;
@@ -54,6 +55,10 @@ class Phantom : public QObject {
     Q_PROPERTY(bool cookiesEnabled READ areCookiesEnabled WRITE setCookiesEnabled)
     Q_PROPERTY(QVariantList cookies READ cookies WRITE setCookies)
     Q_PROPERTY(int remoteDebugPort READ remoteDebugPort)
+    Q_PROPERTY(QVariantMap diskCacheStats READ diskCacheStats)
+    Q_PROPERTY(QVariantMap memoryCacheStats READ memoryCacheStats)
+    Q_PROPERTY(QVariantMap requestCoalescerStats READ requestCoalescerStats)
+    Q_PROPERTY(QVariantMap hostResolverStats READ hostResolverStats)
 
 private:
     // Private constructor: the Phantom class is a singleton
@@ -88,6 +93,12 @@ public:
      */
     Config* config();
 
+    /**
+     * Archive all the pages record network responses to or replay them from,
+     * as set up by the '--network-archive' options, if any.
+     */
+    NetworkArchive* networkArchive() const;
+
     bool printDebugMessages() const;
 
     bool areCookiesEnabled() const;
@@ -95,6 +106,31 @@ public:
 
     int remoteDebugPort() const;
 
+    /**
+     * Hits, misses and bytes saved by the disk caches of this process.
+     * @see DiskCache::stats
+     */
+    QVariantMap diskCacheStats() const;
+
+    /**
+     * Hits, misses and content of the memory cache shared by the pages.
+     * @see MemoryCache::stats
+     */
+    QVariantMap memoryCacheStats() const;
+
+    /**
+     * Identical requests of the pages led, shared and started again.
+     * @see RequestCoalescer::stats
+     */
+    QVariantMap requestCoalescerStats() const;
+
+    /**
+     * Requests sent elsewhere by the host resolver rules, and the hosts
+     * kept resolved with their addresses.
+     * @see HostResolver::stats
+     */
+    QVariantMap hostResolverStats() const;
+
     /**
      * Create `child_process` module instance
      */
@@ -233,6 +269,7 @@ private:
     QList<QPointer<WebServer>> m_servers;
     Config m_config;
     CookieJar* m_defaultCookieJar;
+    NetworkArchive* m_networkArchive;
     qreal m_defaultDpi;
 
     friend class CustomPage;
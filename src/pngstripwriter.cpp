@@ -0,0 +1,258 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pngstripwriter.h"
+
+#include <QIODevice>
+#include <QImage>
+#include <QtEndian>
+
+#include <zlib.h>
+
+// Compressed data is written out in IDAT chunks of (at most) this size
+#define IDAT_CHUNK_SIZE (64 * 1024)
+
+static const int BYTES_PER_PIXEL = 4;
+
+PngStripWriter::PngStripWriter(QIODevice* device, const QSize& size, int quality)
+    : m_device(device)
+    , m_size(size)
+    , m_rowsWritten(0)
+    , m_error(false)
+    , m_finished(false)
+    , m_stream(new z_stream_s)
+{
+    memset(m_stream, 0, sizeof(z_stream_s));
+
+    if (!m_device || !m_device->isWritable() || m_size.isEmpty()) {
+        m_error = true;
+        return;
+    }
+
+    const int rowSize = m_size.width() * BYTES_PER_PIXEL;
+    m_previousRow.fill(0, rowSize);
+    m_filteredRow.resize(rowSize + 1);
+    m_candidateRow.resize(rowSize + 1);
+    m_output.resize(IDAT_CHUNK_SIZE);
+
+    // Map the quality to a compression level the same way Qt's own PNG writer does
+    int level = Z_DEFAULT_COMPRESSION;
+    if (quality >= 0) {
+        level = (100 - qMin(quality, 100)) * 9 / 91;
+    }
+    if (deflateInit(m_stream, level) != Z_OK) {
+        m_error = true;
+        return;
+    }
+    m_stream->next_out = reinterpret_cast<Bytef*>(m_output.data());
+    m_stream->avail_out = m_output.size();
+
+    writeHeader();
+}
+
+PngStripWriter::~PngStripWriter()
+{
+    deflateEnd(m_stream);
+    delete m_stream;
+}
+
+bool PngStripWriter::writeStrip(const QImage& strip)
+{
+    if (m_error || m_finished) {
+        return false;
+    }
+    if (strip.width() != m_size.width() || m_rowsWritten + strip.height() > m_size.height()) {
+        m_error = true;
+        return false;
+    }
+
+    // PNG stores non-premultiplied RGBA, in this very byte order
+    const QImage rows = strip.convertToFormat(QImage::Format_RGBA8888);
+    for (int y = 0; y < rows.height(); ++y) {
+        const uchar* row = rows.constScanLine(y);
+        const uchar* filteredRow = filterRow(row);
+        memcpy(m_previousRow.data(), row, m_previousRow.size());
+
+        m_stream->next_in = const_cast<Bytef*>(filteredRow);
+        m_stream->avail_in = m_previousRow.size() + 1;
+        if (!deflateBuffer(Z_NO_FLUSH)) {
+            return false;
+        }
+    }
+    m_rowsWritten += rows.height();
+    return true;
+}
+
+bool PngStripWriter::finish()
+{
+    if (m_finished) {
+        return !m_error;
+    }
+    m_finished = true;
+
+    if (m_error || m_rowsWritten != m_size.height()) {
+        m_error = true;
+        return false;
+    }
+
+    m_stream->next_in = Z_NULL;
+    m_stream->avail_in = 0;
+    if (!deflateBuffer(Z_FINISH)) {
+        return false;
+    }
+    const int pending = m_output.size() - m_stream->avail_out;
+    if (pending > 0 && !writeChunk("IDAT", m_output.left(pending))) {
+        return false;
+    }
+    return writeChunk("IEND", QByteArray());
+}
+
+bool PngStripWriter::hasError() const
+{
+    return m_error;
+}
+
+// private:
+
+void PngStripWriter::writeHeader()
+{
+    static const char signature[] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    if (m_device->write(signature, sizeof(signature)) != sizeof(signature)) {
+        m_error = true;
+        return;
+    }
+
+    uchar header[13];
+    qToBigEndian<quint32>(m_size.width(), header);
+    qToBigEndian<quint32>(m_size.height(), header + 4);
+    header[8] = 8; // bit depth
+    header[9] = 6; // color type: truecolor with alpha
+    header[10] = 0; // compression method: deflate
+    header[11] = 0; // filter method: adaptive
+    header[12] = 0; // no interlace
+    writeChunk("IHDR", QByteArray(reinterpret_cast<const char*>(header), sizeof(header)));
+}
+
+const uchar* PngStripWriter::filterRow(const uchar* row)
+{
+    // Try all the five PNG filters on the row and keep the one giving the
+    // smallest sum of absolute differences, like libpng does by default.
+    const int length = m_previousRow.size();
+    const uchar* prior = reinterpret_cast<const uchar*>(m_previousRow.constData());
+    uchar* best = reinterpret_cast<uchar*>(m_filteredRow.data());
+    uchar* candidate = reinterpret_cast<uchar*>(m_candidateRow.data());
+    quint64 bestSum = Q_UINT64_C(0xffffffffffffffff);
+
+    for (int type = 0; type < 5; ++type) {
+        quint64 sum = 0;
+        candidate[0] = type;
+        for (int i = 0; i < length; ++i) {
+            const int a = i >= BYTES_PER_PIXEL ? row[i - BYTES_PER_PIXEL] : 0;
+            const int b = prior[i];
+            const int c = i >= BYTES_PER_PIXEL ? prior[i - BYTES_PER_PIXEL] : 0;
+            int predictor = 0;
+            switch (type) {
+            case 1: // Sub
+                predictor = a;
+                break;
+            case 2: // Up
+                predictor = b;
+                break;
+            case 3: // Average
+                predictor = (a + b) / 2;
+                break;
+            case 4: { // Paeth
+                const int pa = qAbs(b - c);
+                const int pb = qAbs(a - c);
+                const int pc = qAbs(a + b - 2 * c);
+                predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                break;
+            }
+            default: // None
+                break;
+            }
+            const uchar value = row[i] - predictor;
+            candidate[i + 1] = value;
+            sum += value < 128 ? value : 256 - value;
+        }
+        if (sum < bestSum) {
+            bestSum = sum;
+            qSwap(best, candidate);
+        }
+    }
+    return best;
+}
+
+bool PngStripWriter::deflateBuffer(int flush)
+{
+    forever {
+        const int ret = deflate(m_stream, flush);
+        if (ret == Z_STREAM_ERROR) {
+            m_error = true;
+            return false;
+        }
+        if (m_stream->avail_out == 0) {
+            // Output buffer is full: ship it and keep going
+            if (!writeChunk("IDAT", m_output)) {
+                return false;
+            }
+            m_stream->next_out = reinterpret_cast<Bytef*>(m_output.data());
+            m_stream->avail_out = m_output.size();
+            continue;
+        }
+        if (flush == Z_FINISH ? ret == Z_STREAM_END : m_stream->avail_in == 0) {
+            return true;
+        }
+    }
+}
+
+bool PngStripWriter::writeChunk(const char* type, const QByteArray& data)
+{
+    if (m_error) {
+        return false;
+    }
+
+    uchar header[8];
+    qToBigEndian<quint32>(data.size(), header);
+    memcpy(header + 4, type, 4);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, header + 4, 4);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data.constData()), data.size());
+    uchar trailer[4];
+    qToBigEndian<quint32>(crc, trailer);
+
+    if (m_device->write(reinterpret_cast<const char*>(header), sizeof(header)) != sizeof(header)
+        || m_device->write(data) != data.size()
+        || m_device->write(reinterpret_cast<const char*>(trailer), sizeof(trailer)) != sizeof(trailer)) {
+        m_error = true;
+        return false;
+    }
+    return true;
+}
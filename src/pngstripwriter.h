@@ -0,0 +1,93 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PNGSTRIPWRITER_H
+#define PNGSTRIPWRITER_H
+
+#include <QByteArray>
+#include <QSize>
+
+class QIODevice;
+class QImage;
+struct z_stream_s;
+
+/**
+ * Incremental PNG encoder.
+ *
+ * The image is handed over as a sequence of horizontal strips, from top to
+ * bottom, and every strip is compressed and written to the device as soon
+ * as it arrives. Only the strip being encoded (plus one scanline of state)
+ * is kept in memory, no matter how tall the final image is.
+ */
+class PngStripWriter {
+public:
+    /**
+     * @param device The device the PNG stream is written to, already open
+     * @param size Size of the whole image
+     * @param quality Same meaning as for QImage::save: 0 to 100, or -1 for the default
+     */
+    PngStripWriter(QIODevice* device, const QSize& size, int quality = -1);
+    ~PngStripWriter();
+
+    /**
+     * Encode the next strip of the image.
+     * The strip must be exactly as wide as the image.
+     *
+     * @return false if something went wrong, in which case the writer stops
+     */
+    bool writeStrip(const QImage& strip);
+
+    /**
+     * Flush the compressed stream and close the PNG file.
+     *
+     * @return true if the whole image has been written successfully
+     */
+    bool finish();
+
+    bool hasError() const;
+
+private:
+    void writeHeader();
+    const uchar* filterRow(const uchar* row);
+    bool deflateBuffer(int flush);
+    bool writeChunk(const char* type, const QByteArray& data);
+
+    QIODevice* m_device;
+    QSize m_size;
+    int m_rowsWritten;
+    bool m_error;
+    bool m_finished;
+    z_stream_s* m_stream;
+    QByteArray m_previousRow;
+    QByteArray m_filteredRow;
+    QByteArray m_candidateRow;
+    QByteArray m_output;
+};
+
+#endif // PNGSTRIPWRITER_H
@@ -0,0 +1,208 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "proxyreply.h"
+
+#include <cstring>
+
+// public:
+ProxyReply::ProxyReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op)
+    : QNetworkReply(parent)
+    , m_reply(Q_NULLPTR)
+    , m_ignoreSslErrors(false)
+{
+    setRequest(req);
+    setUrl(req.url());
+    setOperation(op);
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    qRegisterMetaType<QNetworkReply::NetworkError>();
+}
+
+void ProxyReply::setReply(QNetworkReply* reply)
+{
+    m_reply = reply;
+    m_reply->setParent(this);
+    setUrl(m_reply->url());
+    if (m_ignoreSslErrors) {
+        m_reply->ignoreSslErrors();
+    }
+
+    connect(m_reply, SIGNAL(metaDataChanged()), SLOT(copyMetaData()));
+    connect(m_reply, SIGNAL(readyRead()), SLOT(readReply()));
+    connect(m_reply, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(forwardError(QNetworkReply::NetworkError)));
+    connect(m_reply, SIGNAL(finished()), SLOT(finish()));
+    connect(m_reply, SIGNAL(downloadProgress(qint64, qint64)), SIGNAL(downloadProgress(qint64, qint64)));
+    connect(m_reply, SIGNAL(uploadProgress(qint64, qint64)), SIGNAL(uploadProgress(qint64, qint64)));
+    connect(m_reply, SIGNAL(sslErrors(const QList<QSslError>&)), SIGNAL(sslErrors(const QList<QSslError>&)));
+    connect(m_reply, SIGNAL(encrypted()), SIGNAL(encrypted()));
+
+    // Synchronous requests are over already
+    if (m_reply->isFinished()) {
+        finish();
+    }
+}
+
+QNetworkReply* ProxyReply::reply() const
+{
+    return m_reply;
+}
+
+void ProxyReply::abort()
+{
+    if (m_reply) {
+        m_reply->abort();
+        return;
+    }
+    if (isFinished()) {
+        return;
+    }
+    setError(OperationCanceledError, QLatin1String("Operation canceled"));
+    setFinished(true);
+    emit error(OperationCanceledError);
+    emit finished();
+}
+
+void ProxyReply::ignoreSslErrors()
+{
+    m_ignoreSslErrors = true;
+    if (m_reply) {
+        m_reply->ignoreSslErrors();
+    }
+}
+
+qint64 ProxyReply::bytesAvailable() const
+{
+    return m_buffer.size() + QNetworkReply::bytesAvailable();
+}
+
+// protected:
+qint64 ProxyReply::readData(char* data, qint64 maxSize)
+{
+    const qint64 size = qMin(maxSize, qint64(m_buffer.size()));
+    if (size <= 0) {
+        return isFinished() ? -1 : 0;
+    }
+    memcpy(data, m_buffer.constData(), size);
+    m_buffer.remove(0, size);
+    return size;
+}
+
+void ProxyReply::ignoreSslErrorsImplementation(const QList<QSslError>& errors)
+{
+    if (m_reply) {
+        m_reply->ignoreSslErrors(errors);
+    }
+}
+
+void ProxyReply::setSslConfigurationImplementation(const QSslConfiguration& configuration)
+{
+    if (m_reply) {
+        m_reply->setSslConfiguration(configuration);
+    }
+}
+
+void ProxyReply::sslConfigurationImplementation(QSslConfiguration& configuration) const
+{
+    if (m_reply) {
+        configuration = m_reply->sslConfiguration();
+    }
+}
+
+void ProxyReply::metaDataReceived()
+{
+}
+
+void ProxyReply::bodyReceived(const QByteArray&)
+{
+}
+
+void ProxyReply::replyFinished()
+{
+}
+
+// private slots:
+void ProxyReply::copyMetaData()
+{
+    takeMetaData();
+    metaDataReceived();
+    emit metaDataChanged();
+}
+
+void ProxyReply::readReply()
+{
+    const QByteArray data = m_reply->readAll();
+    if (!data.isEmpty()) {
+        m_buffer += data;
+        bodyReceived(data);
+        emit readyRead();
+    }
+}
+
+void ProxyReply::forwardError(QNetworkReply::NetworkError code)
+{
+    setError(code, m_reply->errorString());
+    emit error(code);
+}
+
+void ProxyReply::finish()
+{
+    readReply();
+    takeMetaData();
+    if (m_reply->error() != NoError) {
+        setError(m_reply->error(), m_reply->errorString());
+    }
+
+    replyFinished();
+    setFinished(true);
+    emit finished();
+}
+
+// private:
+void ProxyReply::takeMetaData()
+{
+    foreach (const RawHeaderPair& header, m_reply->rawHeaderPairs()) {
+        setRawHeader(header.first, header.second);
+    }
+
+    static const QNetworkRequest::Attribute attributes[] = {
+        QNetworkRequest::HttpStatusCodeAttribute,
+        QNetworkRequest::HttpReasonPhraseAttribute,
+        QNetworkRequest::RedirectionTargetAttribute,
+        QNetworkRequest::ConnectionEncryptedAttribute,
+        QNetworkRequest::SourceIsFromCacheAttribute,
+        QNetworkRequest::HttpPipeliningWasUsedAttribute,
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+        QNetworkRequest::HTTP2WasUsedAttribute,
+#endif
+    };
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(attributes[0]); ++i) {
+        setAttribute(attributes[i], m_reply->attribute(attributes[i]));
+    }
+}
@@ -0,0 +1,90 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef PROXYREPLY_H
+#define PROXYREPLY_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+
+/**
+ * Reply standing for another one, which it forwards once given, so that
+ * what goes through can be looked at or the request started later on.
+ *
+ * Until it is given a reply, it only waits; aborting it then fails it as
+ * an aborted request.
+ */
+class ProxyReply : public QNetworkReply {
+    Q_OBJECT
+
+public:
+    ProxyReply(QObject* parent, const QNetworkRequest& req, const QNetworkAccessManager::Operation op);
+
+    /**
+     * Forward this reply, taken over, from now on.
+     */
+    void setReply(QNetworkReply* reply);
+    QNetworkReply* reply() const;
+
+    void abort();
+    void ignoreSslErrors();
+    qint64 bytesAvailable() const;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize);
+    void ignoreSslErrorsImplementation(const QList<QSslError>& errors);
+    void setSslConfigurationImplementation(const QSslConfiguration& configuration);
+    void sslConfigurationImplementation(QSslConfiguration& configuration) const;
+
+    // Hooks for subclasses: the headers, before metaDataChanged() is
+    // emitted, each part of the body as it arrives, and the end of the
+    // reply, before finished() is emitted
+    virtual void metaDataReceived();
+    virtual void bodyReceived(const QByteArray& data);
+    virtual void replyFinished();
+
+private slots:
+    void copyMetaData();
+    void readReply();
+    void forwardError(QNetworkReply::NetworkError code);
+    void finish();
+
+private:
+    void takeMetaData();
+
+    // Gone if it is deleted on its own, e.g. after failed authentication
+    QPointer<QNetworkReply> m_reply;
+    // Received but not read yet
+    QByteArray m_buffer;
+    bool m_ignoreSslErrors;
+};
+
+#endif // PROXYREPLY_H
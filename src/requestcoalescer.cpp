@@ -0,0 +1,214 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "requestcoalescer.h"
+
+#include <algorithm>
+
+#include <QNetworkCookie>
+
+#include "networkaccessmanager.h"
+
+// Bodies bigger than this are not kept for the requests waiting
+#define REQUEST_COALESCER_MAX_BODY_SIZE (10 * 1024 * 1024)
+
+static RequestCoalescer* requestCoalescerInstance = Q_NULLPTR;
+
+// public:
+RequestCoalescer* RequestCoalescer::instance()
+{
+    if (!requestCoalescerInstance) {
+        requestCoalescerInstance = new RequestCoalescer();
+    }
+    return requestCoalescerInstance;
+}
+
+void RequestCoalescer::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool RequestCoalescer::isEnabled() const
+{
+    return m_enabled;
+}
+
+QByteArray RequestCoalescer::requestKey(const QNetworkRequest& request, QNetworkAccessManager::Operation op, const QNetworkCookieJar* cookieJar)
+{
+    const QString scheme = request.url().scheme().toLower();
+    if (op != QNetworkAccessManager::GetOperation
+        || (scheme != QLatin1String("http") && scheme != QLatin1String("https"))
+        || request.attribute(QNetworkRequest::SynchronousRequestAttribute).toBool()
+        || request.attribute(QNetworkRequest::CacheLoadControlAttribute).toInt() == QNetworkRequest::AlwaysNetwork) {
+        return QByteArray();
+    }
+
+    QByteArray key = request.url().toEncoded();
+    QList<QByteArray> names = request.rawHeaderList();
+    std::sort(names.begin(), names.end());
+    foreach (const QByteArray& name, names) {
+        if (name.toLower() != "referer") {
+            key += '\n' + name.toLower() + ": " + request.rawHeader(name);
+        }
+    }
+
+    // The cookies Qt will send, as pages with jars of their own may well have the same
+    if (cookieJar && !request.hasRawHeader("Cookie")
+        && request.attribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Automatic).toInt() == QNetworkRequest::Automatic) {
+        QList<QByteArray> cookies;
+        foreach (const QNetworkCookie& cookie, cookieJar->cookiesForUrl(request.url())) {
+            cookies += cookie.toRawForm(QNetworkCookie::NameAndValueOnly);
+        }
+        key += "\ncookie: " + cookies.join("; ");
+    }
+    return key;
+}
+
+bool RequestCoalescer::isLeading(const QByteArray& key) const
+{
+    return m_enabled && m_followers.contains(key);
+}
+
+void RequestCoalescer::join(const QByteArray& key, ProxyReply* reply)
+{
+    m_followers[key] += QPointer<ProxyReply>(reply);
+}
+
+QNetworkReply* RequestCoalescer::lead(const QByteArray& key, QNetworkReply* reply)
+{
+    if (!m_enabled || key.isEmpty() || m_followers.contains(key)) {
+        return reply;
+    }
+    m_followers.insert(key, QList<QPointer<ProxyReply> >());
+    ++m_led;
+    return new CoalescingReply(reply, key);
+}
+
+void RequestCoalescer::finish(const QByteArray& key, const NetworkArchive::Response* response)
+{
+    // Taken first: the requests started again may lead in turn
+    const QList<QPointer<ProxyReply> > followers = m_followers.take(key);
+    foreach (const QPointer<ProxyReply>& follower, followers) {
+        // Gone with its page, or aborted
+        if (!follower || follower->isFinished()) {
+            continue;
+        }
+
+        if (response) {
+            ++m_shared;
+            // Responses setting cookies are not shared
+            follower->setReply(new ArchivedReply(follower, follower->request(), follower->operation(), *response, Q_NULLPTR));
+            continue;
+        }
+
+        NetworkAccessManager* manager = qobject_cast<NetworkAccessManager*>(follower->parent());
+        if (manager) {
+            ++m_restarted;
+            manager->restartQueuedRequest(follower);
+        }
+    }
+}
+
+QVariantMap RequestCoalescer::stats() const
+{
+    QVariantMap result;
+    // Downloads led, requests answered with their response, and started on their own after all
+    result["led"] = m_led;
+    result["shared"] = m_shared;
+    result["restarted"] = m_restarted;
+    return result;
+}
+
+// private:
+RequestCoalescer::RequestCoalescer()
+    : QObject(Q_NULLPTR)
+    , m_enabled(false)
+    , m_led(0)
+    , m_shared(0)
+    , m_restarted(0)
+{
+}
+
+// CoalescingReply
+
+CoalescingReply::CoalescingReply(QNetworkReply* reply, const QByteArray& key)
+    : ProxyReply(reply->parent(), reply->request(), reply->operation())
+    , m_key(key)
+    , m_oversized(false)
+    , m_done(false)
+{
+    setReply(reply);
+}
+
+CoalescingReply::~CoalescingReply()
+{
+    // Deleted before finishing, with its page
+    if (!m_done) {
+        RequestCoalescer::instance()->finish(m_key, Q_NULLPTR);
+    }
+}
+
+// protected:
+void CoalescingReply::bodyReceived(const QByteArray& data)
+{
+    if (m_oversized) {
+        return;
+    }
+    if (m_body.size() + data.size() > REQUEST_COALESCER_MAX_BODY_SIZE) {
+        m_oversized = true;
+        m_body.clear();
+        return;
+    }
+    m_body += data;
+}
+
+void CoalescingReply::replyFinished()
+{
+    m_done = true;
+    if (!isShareable()) {
+        RequestCoalescer::instance()->finish(m_key, Q_NULLPTR);
+        return;
+    }
+    const NetworkArchive::Response response = NetworkArchive::response(this, m_body);
+    RequestCoalescer::instance()->finish(m_key, &response);
+}
+
+// private:
+bool CoalescingReply::isShareable() const
+{
+    if (m_oversized || error() != NoError || attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+        return false;
+    }
+    if (hasRawHeader("Set-Cookie")) {
+        return false;
+    }
+    const QByteArray cacheControl = rawHeader("Cache-Control").toLower();
+    return !cacheControl.contains("no-store") && !cacheControl.contains("private");
+}
@@ -0,0 +1,128 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef REQUESTCOALESCER_H
+#define REQUESTCOALESCER_H
+
+#include <QHash>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkCookieJar>
+#include <QObject>
+#include <QPointer>
+#include <QVariantMap>
+
+#include "networkarchive.h"
+#include "proxyreply.h"
+
+/**
+ * Lets identical GET requests made at the same time, by any of the pages
+ * of the process, share one download.
+ *
+ * The first of them to start leads: its reply is handed out as a
+ * CoalescingReply, which keeps the response as it goes by. Those made
+ * until it finishes wait, as ProxyReply objects, and are then answered
+ * with a copy of the response. When it can not be shared (an error, a
+ * status other than 200, "Cache-Control: no-store" or "private", cookies
+ * set, a body over 10 MB, a lead aborted or gone with its page), they are
+ * started on their own instead, within the connection limits.
+ */
+class RequestCoalescer : public QObject {
+    Q_OBJECT
+
+public:
+    static RequestCoalescer* instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /**
+     * Identical requests have the same key: same URL, headers but for the
+     * referrer, and cookies sent from the jar. It is empty for requests
+     * never coalesced: other than GET or HTTP(S), synchronous, or reloads.
+     */
+    static QByteArray requestKey(const QNetworkRequest& request, QNetworkAccessManager::Operation op, const QNetworkCookieJar* cookieJar);
+
+    bool isLeading(const QByteArray& key) const;
+
+    /**
+     * The reply, not started, waits for the request leading with this key.
+     * Unless it is answered, it is handed to the NetworkAccessManager that
+     * made it, to be started.
+     */
+    void join(const QByteArray& key, ProxyReply* reply);
+
+    /**
+     * The reply to hand out instead of this one, which it takes over,
+     * leading the requests with this key until it finishes.
+     */
+    QNetworkReply* lead(const QByteArray& key, QNetworkReply* reply);
+
+    // For CoalescingReply: the lead is over, with a response to share or not
+    void finish(const QByteArray& key, const NetworkArchive::Response* response);
+
+    QVariantMap stats() const;
+
+private:
+    RequestCoalescer();
+
+    bool m_enabled;
+    // Requests waiting, by key of the lead going on
+    QHash<QByteArray, QList<QPointer<ProxyReply> > > m_followers;
+    int m_led;
+    int m_shared;
+    int m_restarted;
+};
+
+/**
+ * Reply leading the requests identical to its own, keeping the response
+ * for them.
+ */
+class CoalescingReply : public ProxyReply {
+    Q_OBJECT
+
+public:
+    CoalescingReply(QNetworkReply* reply, const QByteArray& key);
+    ~CoalescingReply();
+
+protected:
+    void bodyReceived(const QByteArray& data);
+    void replyFinished();
+
+private:
+    bool isShareable() const;
+
+    QByteArray m_key;
+    QByteArray m_body;
+    bool m_oversized;
+    bool m_done;
+};
+
+#endif // REQUESTCOALESCER_H
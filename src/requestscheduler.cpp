@@ -0,0 +1,158 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "requestscheduler.h"
+
+#include "networkaccessmanager.h"
+#include "proxyreply.h"
+
+// Bits of the queue keys given to the arrival order, under the priority
+#define REQUEST_SCHEDULER_SEQUENCE_BITS 48
+
+static RequestScheduler* requestSchedulerInstance = Q_NULLPTR;
+
+// public:
+RequestScheduler* RequestScheduler::instance()
+{
+    if (!requestSchedulerInstance) {
+        requestSchedulerInstance = new RequestScheduler();
+    }
+    return requestSchedulerInstance;
+}
+
+void RequestScheduler::setLimits(int maxConnections, int maxConnectionsPerHost)
+{
+    m_maxConnections = qMax(0, maxConnections);
+    m_maxConnectionsPerHost = qMax(0, maxConnectionsPerHost);
+    dispatch();
+}
+
+bool RequestScheduler::isLimited() const
+{
+    return m_maxConnections > 0 || m_maxConnectionsPerHost > 0;
+}
+
+void RequestScheduler::enqueue(ProxyReply* reply, int priority)
+{
+    Queued queued;
+    queued.reply = reply;
+    queued.host = reply->url().host().toLower();
+    const quint64 key = (quint64(qBound(0, priority, 0xffff)) << REQUEST_SCHEDULER_SEQUENCE_BITS) | m_sequence++;
+    m_queue.insert(key, queued);
+    dispatch();
+}
+
+int RequestScheduler::queuedCount() const
+{
+    return m_queue.size();
+}
+
+int RequestScheduler::activeCount() const
+{
+    return m_active.size();
+}
+
+// private slots:
+void RequestScheduler::replyFinished()
+{
+    release(sender());
+}
+
+void RequestScheduler::replyDestroyed(QObject* reply)
+{
+    release(reply);
+}
+
+// private:
+RequestScheduler::RequestScheduler()
+    : QObject(Q_NULLPTR)
+    , m_maxConnections(0)
+    , m_maxConnectionsPerHost(0)
+    , m_sequence(0)
+{
+}
+
+void RequestScheduler::dispatch()
+{
+    QList<ProxyReply*> starting;
+
+    QMap<quint64, Queued>::iterator it = m_queue.begin();
+    while (it != m_queue.end()) {
+        if (m_maxConnections > 0 && m_active.size() >= m_maxConnections) {
+            break;
+        }
+
+        ProxyReply* reply = it.value().reply.data();
+        // Gone, or aborted while waiting
+        if (!reply || reply->isFinished()) {
+            it = m_queue.erase(it);
+            continue;
+        }
+
+        const QString host = it.value().host;
+        if (m_maxConnectionsPerHost > 0 && m_activeByHost.value(host) >= m_maxConnectionsPerHost) {
+            ++it;
+            continue;
+        }
+
+        it = m_queue.erase(it);
+        m_active.insert(reply, host);
+        ++m_activeByHost[host];
+        connect(reply, SIGNAL(finished()), SLOT(replyFinished()));
+        connect(reply, SIGNAL(destroyed(QObject*)), SLOT(replyDestroyed(QObject*)));
+        starting += reply;
+    }
+
+    // Started once the queue is left alone, as replies can finish right away
+    foreach (ProxyReply* reply, starting) {
+        NetworkAccessManager* manager = qobject_cast<NetworkAccessManager*>(reply->parent());
+        if (manager) {
+            manager->startQueuedRequest(reply);
+        } else {
+            reply->abort();
+        }
+    }
+}
+
+void RequestScheduler::release(QObject* reply)
+{
+    QHash<QObject*, QString>::iterator it = m_active.find(reply);
+    if (it == m_active.end()) {
+        return;
+    }
+
+    const QString host = it.value();
+    m_active.erase(it);
+    if (--m_activeByHost[host] <= 0) {
+        m_activeByHost.remove(host);
+    }
+    disconnect(reply, Q_NULLPTR, this, Q_NULLPTR);
+    dispatch();
+}
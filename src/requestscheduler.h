@@ -0,0 +1,96 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef REQUESTSCHEDULER_H
+#define REQUESTSCHEDULER_H
+
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+
+class ProxyReply;
+
+/**
+ * Limits how many requests the pages of the process have going at once,
+ * in all and to each host, starting the queued ones by priority, then in
+ * the order they came.
+ *
+ * Requests are queued as ProxyReply objects; when its turn comes, one is
+ * handed to the NetworkAccessManager that made it, to be started.
+ */
+class RequestScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    static RequestScheduler* instance();
+
+    /**
+     * @param maxConnections requests going at once in all, or 0 for no limit
+     * @param maxConnectionsPerHost requests going at once to one host, or 0
+     *        to leave it to Qt
+     */
+    void setLimits(int maxConnections, int maxConnectionsPerHost);
+    bool isLimited() const;
+
+    /**
+     * @param priority lower values go first
+     */
+    void enqueue(ProxyReply* reply, int priority);
+
+    int queuedCount() const;
+    int activeCount() const;
+
+private slots:
+    void replyFinished();
+    void replyDestroyed(QObject* reply);
+
+private:
+    RequestScheduler();
+
+    void dispatch();
+    void release(QObject* reply);
+
+    struct Queued {
+        QPointer<ProxyReply> reply;
+        QString host;
+    };
+
+    int m_maxConnections;
+    int m_maxConnectionsPerHost;
+    // By priority, then arrival
+    QMap<quint64, Queued> m_queue;
+    quint64 m_sequence;
+    // Host of each request going on
+    QHash<QObject*, QString> m_active;
+    QHash<QString, int> m_activeByHost;
+};
+
+#endif // REQUESTSCHEDULER_H
@@ -0,0 +1,268 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "resourcerules.h"
+
+#include <QDebug>
+#include <QNetworkRequest>
+#include <QRegExp>
+#include <QUrl>
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+static ResourceRules::Action actionFromString(const QString& action)
+{
+    if (action == QLatin1String("block")) {
+        return ResourceRules::Block;
+    }
+    if (action == QLatin1String("rewrite")) {
+        return ResourceRules::Rewrite;
+    }
+    if (action == QLatin1String("allow")) {
+        return ResourceRules::Allow;
+    }
+    return ResourceRules::NoAction;
+}
+
+// Only "*" is special: "?" is too common in URLs to be a wildcard.
+static QRegularExpression globToRegularExpression(const QString& glob, QString* literal)
+{
+    QString pattern("^");
+    foreach (const QString& part, glob.split(QLatin1Char('*'))) {
+        if (part.length() > literal->length()) {
+            *literal = part;
+        }
+        pattern += QRegularExpression::escape(part) + QLatin1String(".*");
+    }
+    pattern.chop(2);
+    pattern += QLatin1Char('$');
+
+    return QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
+}
+
+ResourceRules::ResourceRules()
+{
+}
+
+void ResourceRules::setRules(const QVariantList& rules)
+{
+    m_rules = rules;
+    m_compiled.clear();
+    m_domainIndex.clear();
+    m_domainlessRules.clear();
+
+    foreach (const QVariant& item, rules) {
+        QVariantMap map = item.toMap();
+        Rule rule;
+
+        rule.isRegularExpression = false;
+        rule.action = actionFromString(map.value("action").toString());
+        if (rule.action == NoAction) {
+            qWarning() << "Resource rules - Unknown action:" << map.value("action").toString();
+            continue;
+        }
+
+        QVariant url = map.value("url");
+        if (url.type() == QVariant::RegularExpression) {
+            rule.pattern = url.toRegularExpression();
+            rule.isRegularExpression = true;
+        } else if (url.type() == QVariant::RegExp) {
+            // What JavaScript RegExp objects arrive as
+            QRegExp regExp = url.toRegExp();
+            rule.pattern = QRegularExpression(regExp.pattern(),
+                regExp.caseSensitivity() == Qt::CaseInsensitive ? QRegularExpression::CaseInsensitiveOption : QRegularExpression::NoPatternOption);
+            rule.isRegularExpression = true;
+        } else if (!url.toString().isEmpty()) {
+            rule.pattern = globToRegularExpression(url.toString(), &rule.literal);
+        }
+        if (!rule.pattern.pattern().isEmpty()) {
+            if (!rule.pattern.isValid()) {
+                qWarning() << "Resource rules - Invalid URL pattern:" << rule.pattern.pattern()
+                           << "(" << rule.pattern.errorString() << ")";
+                continue;
+            }
+            rule.pattern.optimize();
+        }
+
+        rule.rewrite = map.value("to").toString();
+        if (rule.action == Rewrite && rule.rewrite.isEmpty()) {
+            qWarning() << "Resource rules - Rewrite rule without a target URL";
+            continue;
+        }
+
+        foreach (const QVariant& type, map.value("types").toList()) {
+            rule.types += type.toString().toLower();
+        }
+
+        const int index = m_compiled.size();
+        QStringList domains = map.value("domains").toStringList();
+        if (domains.isEmpty()) {
+            m_domainlessRules += index;
+        } else {
+            foreach (const QString& domain, domains) {
+                QVector<int>& indexes = m_domainIndex[domain.toLower()];
+                if (indexes.isEmpty() || indexes.last() != index) {
+                    indexes += index;
+                }
+            }
+        }
+        m_compiled += rule;
+    }
+}
+
+QVariantList ResourceRules::rules() const
+{
+    return m_rules;
+}
+
+bool ResourceRules::isEmpty() const
+{
+    return m_compiled.isEmpty();
+}
+
+ResourceRules::Action ResourceRules::match(const QNetworkRequest& request, QUrl* rewrittenUrl) const
+{
+    if (m_compiled.isEmpty()) {
+        return NoAction;
+    }
+
+    // Rules listing the host or one of its parent domains
+    QVarLengthArray<int, 16> candidates;
+    if (!m_domainIndex.isEmpty()) {
+        QString domain = request.url().host().toLower();
+        while (!domain.isEmpty()) {
+            QHash<QString, QVector<int> >::const_iterator it = m_domainIndex.constFind(domain);
+            if (it != m_domainIndex.constEnd()) {
+                foreach (int index, it.value()) {
+                    candidates.append(index);
+                }
+            }
+            const int dot = domain.indexOf(QLatin1Char('.'));
+            domain = dot < 0 ? QString() : domain.mid(dot + 1);
+        }
+        std::sort(candidates.begin(), candidates.end());
+    }
+
+    const QString url = QString::fromLatin1(request.url().toEncoded());
+    QString type;
+
+    // Merge with the rules for any domain, in the order they were given
+    int i = 0, j = 0;
+    while (i < candidates.size() || j < m_domainlessRules.size()) {
+        int index;
+        if (j >= m_domainlessRules.size() || (i < candidates.size() && candidates[i] < m_domainlessRules[j])) {
+            index = candidates[i++];
+        } else {
+            index = m_domainlessRules[j++];
+        }
+
+        const Rule& rule = m_compiled.at(index);
+        if (!matches(rule, url, request, type)) {
+            continue;
+        }
+
+        if (rule.action == Rewrite) {
+            QString target = rule.rewrite;
+            if (rule.isRegularExpression) {
+                target = url;
+                target.replace(rule.pattern, rule.rewrite);
+            }
+            *rewrittenUrl = QUrl::fromEncoded(target.toLatin1());
+        }
+        return rule.action;
+    }
+
+    return NoAction;
+}
+
+QString ResourceRules::resourceType(const QNetworkRequest& request)
+{
+    const QString path = request.url().path();
+    const QString extension = path.mid(path.lastIndexOf(QLatin1Char('.')) + 1).toLower();
+
+    if (extension == "js") {
+        return "script";
+    }
+    if (extension == "css") {
+        return "stylesheet";
+    }
+    if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "gif"
+        || extension == "webp" || extension == "svg" || extension == "ico" || extension == "bmp") {
+        return "image";
+    }
+    if (extension == "woff" || extension == "woff2" || extension == "ttf" || extension == "otf"
+        || extension == "eot") {
+        return "font";
+    }
+    if (extension == "mp4" || extension == "webm" || extension == "ogg" || extension == "mp3"
+        || extension == "wav") {
+        return "media";
+    }
+    if (extension == "html" || extension == "htm") {
+        return "document";
+    }
+
+    // WebKit asks for what it expects
+    const QByteArray accept = request.rawHeader("Accept");
+    if (accept.startsWith("text/css")) {
+        return "stylesheet";
+    }
+    if (accept.startsWith("image/")) {
+        return "image";
+    }
+    if (accept.startsWith("text/html")) {
+        return "document";
+    }
+
+    return "other";
+}
+
+// private:
+
+bool ResourceRules::matches(const Rule& rule, const QString& url, const QNetworkRequest& request, QString& type) const
+{
+    if (!rule.types.isEmpty()) {
+        if (type.isEmpty()) {
+            type = resourceType(request);
+        }
+        if (!rule.types.contains(type)) {
+            return false;
+        }
+    }
+
+    if (rule.pattern.pattern().isEmpty()) {
+        return true;
+    }
+    if (!rule.literal.isEmpty() && !url.contains(rule.literal, Qt::CaseInsensitive)) {
+        return false;
+    }
+    return rule.pattern.match(url).hasMatch();
+}
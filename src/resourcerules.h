@@ -0,0 +1,106 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef RESOURCERULES_H
+#define RESOURCERULES_H
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+class QNetworkRequest;
+class QUrl;
+
+/**
+ * Declarative rules to block or rewrite requests, matched in C++ before
+ * a request reaches JavaScript.
+ *
+ * Each rule is a map with an "action" ("block", "rewrite" or "allow") and
+ * any of these criteria, all of which must hold for the rule to match:
+ *  - "url": a glob where "*" matches anything, or a regular expression;
+ *  - "domains": host names, also matching all their subdomains;
+ *  - "types": resource types as returned by resourceType().
+ * "rewrite" rules give the new URL in "to"; with a regular expression,
+ * "\1" and so on refer to its captures. The first matching rule wins, so
+ * "allow" rules make exceptions to the rules after them.
+ */
+class ResourceRules {
+public:
+    enum Action {
+        NoAction,
+        Allow,
+        Block,
+        Rewrite
+    };
+
+    ResourceRules();
+
+    void setRules(const QVariantList& rules);
+    QVariantList rules() const;
+    bool isEmpty() const;
+
+    /**
+     * Find the first rule matching the request.
+     * @param request the outgoing request
+     * @param rewrittenUrl receives the new URL when a "rewrite" rule matches
+     * @return the action of the matching rule, NoAction if none matches
+     */
+    Action match(const QNetworkRequest& request, QUrl* rewrittenUrl) const;
+
+    /**
+     * Guess what a request is for, from its URL and Accept header: one of
+     * "document", "stylesheet", "script", "image", "font", "media" or "other".
+     */
+    static QString resourceType(const QNetworkRequest& request);
+
+private:
+    struct Rule {
+        Action action;
+        QRegularExpression pattern;
+        // A regular expression given as such, whose captures "to" may use
+        bool isRegularExpression;
+        // Text any URL matching the pattern contains: a cheap test first
+        QString literal;
+        QStringList types;
+        QString rewrite;
+    };
+
+    bool matches(const Rule& rule, const QString& url, const QNetworkRequest& request, QString& type) const;
+
+    QVariantList m_rules;
+    QVector<Rule> m_compiled;
+    // Rules with "domains", by domain, so only those for the host are tried
+    QHash<QString, QVector<int> > m_domainIndex;
+    QVector<int> m_domainlessRules;
+};
+
+#endif // RESOURCERULES_H
@@ -38,6 +38,13 @@
 #include "../env.h"
 #include "terminal.h"
 
+#if defined(Q_OS_LINUX)
+#include <QFile>
+#include <unistd.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#endif
+
 #if defined(Q_OS_LINUX) || defined(Q_OS_MAC)
 #include <sys/utsname.h>
 QString getOSRelease()
@@ -209,6 +216,32 @@ bool System::isSSLSupported() const
     return QSslSocket::supportsSsl();
 }
 
+QString System::executablePath() const
+{
+    return QApplication::applicationFilePath();
+}
+
+qint64 System::residentSetSize() const
+{
+#if defined(Q_OS_LINUX)
+    // "size resident shared ...", counted in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+#endif
+    return -1;
+}
+
 QObject* System::_stdout()
 {
     if (!m_stdout) {
@@ -48,6 +48,8 @@ class System : public QObject {
     Q_PROPERTY(QVariant env READ env)
     Q_PROPERTY(QVariant os READ os)
     Q_PROPERTY(bool isSSLSupported READ isSSLSupported)
+    Q_PROPERTY(QString executablePath READ executablePath)
+    Q_PROPERTY(qint64 residentSetSize READ residentSetSize)
     Q_PROPERTY(QObject* standardout READ _stdout)
     Q_PROPERTY(QObject* standarderr READ _stderr)
     Q_PROPERTY(QObject* standardin READ _stdin)
@@ -67,6 +69,11 @@ public:
 
     bool isSSLSupported() const;
 
+    QString executablePath() const;
+
+    // Memory held in RAM by this process, in bytes; -1 if unknown
+    qint64 residentSetSize() const;
+
     // system.stdout
     QObject* _stdout();
 
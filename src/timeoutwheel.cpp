@@ -0,0 +1,146 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "timeoutwheel.h"
+
+#include <QList>
+
+#define TIMEOUT_WHEEL_TICK 10
+// A turn of the wheel is a bit more than 5 seconds, longer deadlines wait for more turns
+#define TIMEOUT_WHEEL_SLOTS 512
+
+// public:
+TimeoutWheel::TimeoutWheel(QObject* parent)
+    : QObject(parent)
+    , m_tick(0)
+    , m_wakeTick(0)
+    , m_slots(TIMEOUT_WHEEL_SLOTS)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(tick()));
+}
+
+void TimeoutWheel::schedule(QObject* object, int kind, int msec)
+{
+    cancel(object, kind);
+
+    if (m_deadlines.isEmpty()) {
+        m_tick = currentTick();
+    }
+
+    const Key key(object, kind);
+    const qint64 deadline = qMax((m_clock.elapsed() + qMax(msec, 0) + TIMEOUT_WHEEL_TICK - 1) / TIMEOUT_WHEEL_TICK, m_tick + 1);
+    m_deadlines.insert(key, deadline);
+    m_slots[deadline % TIMEOUT_WHEEL_SLOTS].insert(key);
+
+    // When its slot comes up in the turn after the last tick handled
+    const qint64 tick = m_tick + 1 + (deadline - m_tick - 1) % TIMEOUT_WHEEL_SLOTS;
+    if (!m_timer.isActive() || tick < m_wakeTick) {
+        wakeAt(tick);
+    }
+}
+
+void TimeoutWheel::cancel(QObject* object, int kind)
+{
+    const Key key(object, kind);
+    QHash<Key, qint64>::iterator it = m_deadlines.find(key);
+    if (it == m_deadlines.end()) {
+        return;
+    }
+    m_slots[it.value() % TIMEOUT_WHEEL_SLOTS].remove(key);
+    m_deadlines.erase(it);
+
+    // Otherwise the timer may fire for a slot emptied since, and be set again then
+    if (m_deadlines.isEmpty()) {
+        m_timer.stop();
+    }
+}
+
+int TimeoutWheel::pendingCount() const
+{
+    return m_deadlines.size();
+}
+
+// private slots:
+void TimeoutWheel::tick()
+{
+    const qint64 now = currentTick();
+    QList<Key> due;
+
+    // The timer may be late: go over every slot passed since the last tick,
+    // but not more than a turn
+    const qint64 first = qMax(m_tick + 1, now - TIMEOUT_WHEEL_SLOTS + 1);
+    for (qint64 tick = first; tick <= now; ++tick) {
+        QSet<Key>& slot = m_slots[tick % TIMEOUT_WHEEL_SLOTS];
+        QSet<Key>::iterator it = slot.begin();
+        while (it != slot.end()) {
+            if (m_deadlines.value(*it) <= now) {
+                due += *it;
+                m_deadlines.remove(*it);
+                it = slot.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    m_tick = now;
+
+    if (!m_deadlines.isEmpty()) {
+        wakeAt(nextTick());
+    }
+
+    // Handlers may schedule and cancel deadlines
+    foreach (const Key& key, due) {
+        emit expired(key.first, key.second);
+    }
+}
+
+// private:
+qint64 TimeoutWheel::currentTick() const
+{
+    return m_clock.elapsed() / TIMEOUT_WHEEL_TICK;
+}
+
+qint64 TimeoutWheel::nextTick() const
+{
+    for (qint64 tick = m_tick + 1; tick <= m_tick + TIMEOUT_WHEEL_SLOTS; ++tick) {
+        if (!m_slots[tick % TIMEOUT_WHEEL_SLOTS].isEmpty()) {
+            return tick;
+        }
+    }
+    return m_tick + TIMEOUT_WHEEL_SLOTS;
+}
+
+void TimeoutWheel::wakeAt(qint64 tick)
+{
+    m_wakeTick = tick;
+    m_timer.start(int(qMax(tick * TIMEOUT_WHEEL_TICK - m_clock.elapsed(), qint64(0))));
+}
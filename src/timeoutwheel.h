@@ -0,0 +1,95 @@
+/*
+  This file is part of the PhantomJS project from Ofi Labs.
+
+  Copyright (C) 2011 Ariya Hidayat <ariya.hidayat@gmail.com>
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the <organization> nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef TIMEOUTWHEEL_H
+#define TIMEOUTWHEEL_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * Deadlines for many objects at once, driven by a single timer.
+ *
+ * Deadlines are rounded up to ticks and hashed into the slots of a wheel
+ * by their tick, so scheduling and cancelling cost the same however many
+ * deadlines there are; each tick only looks at the deadlines of one slot.
+ * The timer is set for the first slot holding deadlines, so it does not
+ * fire while none is due: at most once a turn for deadlines further off,
+ * and never while no deadline is pending.
+ *
+ * An object can have one deadline of each kind, e.g. one for its first
+ * byte and one for its whole transfer.
+ */
+class TimeoutWheel : public QObject {
+    Q_OBJECT
+
+public:
+    TimeoutWheel(QObject* parent = Q_NULLPTR);
+
+    /**
+     * Replaces the deadline of this kind the object may have.
+     * @param msec from now, rounded up to the tick
+     */
+    void schedule(QObject* object, int kind, int msec);
+    void cancel(QObject* object, int kind);
+    int pendingCount() const;
+
+signals:
+    // The deadline is gone once this is emitted
+    void expired(QObject* object, int kind);
+
+private slots:
+    void tick();
+
+private:
+    typedef QPair<QObject*, int> Key;
+
+    qint64 currentTick() const;
+    // First tick after the last one handled whose slot holds deadlines
+    qint64 nextTick() const;
+    void wakeAt(qint64 tick);
+
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    // Last tick handled
+    qint64 m_tick;
+    // Tick the timer is set for
+    qint64 m_wakeTick;
+    QVector<QSet<Key> > m_slots;
+    // Tick of each deadline
+    QHash<Key, qint64> m_deadlines;
+};
+
+#endif // TIMEOUTWHEEL_H
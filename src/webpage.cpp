@@ -37,10 +37,12 @@
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QImageWriter>
 #include <QKeyEvent>
 #include <QMapIterator>
+#include <QMetaMethod>
 #include <QMouseEvent>
 #include <QNetworkAccessManager>
 #include <QNetworkCookie>
@@ -59,13 +61,18 @@
 #include <math.h>
 
 #include "callback.h"
+#include "childprocess.h"
 #include "config.h"
 #include "consts.h"
 #include "cookiejar.h"
+#include "filesystem.h"
+#include "memorycache.h"
 #include "networkaccessmanager.h"
 #include "phantom.h"
+#include "pngstripwriter.h"
 #include "system.h"
 #include "utils.h"
+#include "webserver.h"
 
 #ifdef Q_OS_WIN
 #include <fcntl.h>
@@ -77,6 +84,7 @@
 #define CALLBACKS_OBJECT_NAME "_phantom"
 #define INPAGE_CALL_NAME "window.callPhantom"
 #define CALLBACKS_OBJECT_INJECTION INPAGE_CALL_NAME " = function() { return window." CALLBACKS_OBJECT_NAME ".call.call(_phantom, Array.prototype.slice.call(arguments, 0)); };"
+#define RENDER_TARGET_CHUNK_SIZE (64 * 1024)
 #define CALLBACKS_OBJECT_PRESENT "typeof(window." CALLBACKS_OBJECT_NAME ") !== \"undefined\";"
 
 #define STDOUT_FILENAME "/dev/stdout"
@@ -344,8 +352,94 @@ private:
     friend class WebPage;
 };
 
+/**
+  * Write-only device handing the rendered bytes over to a scriptable object
+  * (a File, a WebServerResponse or a ChildProcessContext) as they are,
+  * with no base64 or QString conversion on the way.
+  * Small writes coming from the encoders are collected before being forwarded.
+  *
+  * @class RenderTargetDevice
+  */
+class RenderTargetDevice : public QIODevice {
+public:
+    RenderTargetDevice(QObject* target)
+        : QIODevice()
+        , m_target(target)
+        , m_error(false)
+    {
+    }
+
+    bool open(OpenMode mode)
+    {
+        if (!qobject_cast<File*>(m_target)
+            && !qobject_cast<WebServerResponse*>(m_target)
+            && !qobject_cast<ChildProcessContext*>(m_target)) {
+            return false;
+        }
+        return QIODevice::open(mode);
+    }
+
+    void close()
+    {
+        forward();
+        QIODevice::close();
+    }
+
+    bool isSequential() const
+    {
+        return true;
+    }
+
+    bool hasError() const
+    {
+        return m_error;
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+    qint64 writeData(const char* data, qint64 size)
+    {
+        m_pending.append(data, size);
+        if (m_pending.size() >= RENDER_TARGET_CHUNK_SIZE && !forward()) {
+            return -1;
+        }
+        return size;
+    }
+
+private:
+    bool forward()
+    {
+        if (m_pending.isEmpty() || m_error) {
+            return !m_error;
+        }
+
+        bool ok;
+        if (File* file = qobject_cast<File*>(m_target)) {
+            ok = file->writeBytes(m_pending);
+        } else if (WebServerResponse* response = qobject_cast<WebServerResponse*>(m_target)) {
+            ok = response->writeBytes(m_pending);
+        } else {
+            ok = qobject_cast<ChildProcessContext*>(m_target)->writeBytes(m_pending) == m_pending.size();
+        }
+        m_pending.clear();
+        m_error = !ok;
+        return ok;
+    }
+
+    QObject* m_target;
+    QByteArray m_pending;
+    bool m_error;
+};
+
 WebPage::WebPage(QObject* parent, const QUrl& baseUrl)
     : QObject(parent)
+    , m_networkAccessManager(Q_NULLPTR)
     , m_navigationLocked(false)
     , m_mousePos(QPoint(0, 0))
     , m_ownsPages(true)
@@ -430,6 +524,9 @@ WebPage::WebPage(QObject* parent, const QUrl& baseUrl)
         SIGNAL(resourceError(QVariant)));
     connect(m_networkAccessManager, SIGNAL(resourceTimeout(QVariant)),
         SIGNAL(resourceTimeout(QVariant)));
+    connect(m_networkAccessManager, SIGNAL(networkIdle()),
+        SLOT(handleNetworkIdle()));
+    updateReportedResourceSignals();
 
     m_dpi = qRound(QApplication::primaryScreen()->logicalDotsPerInch());
     m_customWebPage->setViewportSize(QSize(400, 300));
@@ -650,6 +747,22 @@ void WebPage::applySettings(const QVariantMap& def)
         m_networkAccessManager->setResourceTimeout(def[PAGE_SETTINGS_RESOURCE_TIMEOUT].toInt());
     }
 
+    if (def.contains(PAGE_SETTINGS_RESOURCE_FIRST_BYTE_TIMEOUT)) {
+        m_networkAccessManager->setResourceFirstByteTimeout(def[PAGE_SETTINGS_RESOURCE_FIRST_BYTE_TIMEOUT].toInt());
+    }
+
+    if (def.contains(PAGE_SETTINGS_HTTP2_ENABLED)) {
+        m_networkAccessManager->setHttp2Enabled(def[PAGE_SETTINGS_HTTP2_ENABLED].toBool());
+    }
+
+    if (def.contains(PAGE_SETTINGS_HTTP2_CLEARTEXT_ENABLED)) {
+        m_networkAccessManager->setHttp2CleartextEnabled(def[PAGE_SETTINGS_HTTP2_CLEARTEXT_ENABLED].toBool());
+    }
+
+    if (def.contains(PAGE_SETTINGS_POST_DATA_CAPTURE_SIZE)) {
+        m_networkAccessManager->setPostDataCaptureSize(def[PAGE_SETTINGS_POST_DATA_CAPTURE_SIZE].toInt());
+    }
+
     if (def.contains(PAGE_SETTINGS_PROXY)) {
         setProxy(def[PAGE_SETTINGS_PROXY].toString());
     }
@@ -657,6 +770,18 @@ void WebPage::applySettings(const QVariantMap& def)
     if (def.contains(PAGE_SETTINGS_DPI)) {
         m_dpi = def[PAGE_SETTINGS_DPI].toReal();
     }
+
+    if (def.contains(PAGE_SETTINGS_RESOURCE_PRIORITIES)) {
+        m_networkAccessManager->setResourcePriorities(def[PAGE_SETTINGS_RESOURCE_PRIORITIES].toStringList());
+    }
+
+    if (def.contains(PAGE_SETTINGS_NETWORK_IDLE_TIME)) {
+        m_networkAccessManager->setNetworkIdleTime(def[PAGE_SETTINGS_NETWORK_IDLE_TIME].toInt());
+    }
+
+    if (def.contains(PAGE_SETTINGS_NETWORK_IDLE_MAX_INFLIGHT)) {
+        m_networkAccessManager->setNetworkIdleMaxInflight(def[PAGE_SETTINGS_NETWORK_IDLE_MAX_INFLIGHT].toInt());
+    }
 }
 
 void WebPage::setProxy(const QString& proxyUrl)
@@ -676,6 +801,42 @@ QString WebPage::userAgent() const
     return m_customWebPage->m_userAgent;
 }
 
+void WebPage::connectNotify(const QMetaMethod& signal)
+{
+    QObject::connectNotify(signal);
+    updateReportedResourceSignals();
+}
+
+void WebPage::disconnectNotify(const QMetaMethod& signal)
+{
+    QObject::disconnectNotify(signal);
+    updateReportedResourceSignals();
+}
+
+// The network access manager only builds the data of the resource signals
+// someone is listening to.
+void WebPage::updateReportedResourceSignals()
+{
+    if (!m_networkAccessManager) {
+        return;
+    }
+
+    int reported = 0;
+    if (isSignalConnected(QMetaMethod::fromSignal(&WebPage::resourceRequested))) {
+        reported |= NetworkAccessManager::ReportResourceRequested;
+    }
+    if (isSignalConnected(QMetaMethod::fromSignal(&WebPage::resourceReceived))) {
+        reported |= NetworkAccessManager::ReportResourceReceived;
+    }
+    if (isSignalConnected(QMetaMethod::fromSignal(&WebPage::resourceError))) {
+        reported |= NetworkAccessManager::ReportResourceError;
+    }
+    if (isSignalConnected(QMetaMethod::fromSignal(&WebPage::resourceTimeout))) {
+        reported |= NetworkAccessManager::ReportResourceTimeout;
+    }
+    m_networkAccessManager->setReportedSignals(reported);
+}
+
 void WebPage::setNavigationLocked(bool lock)
 {
     m_navigationLocked = lock;
@@ -826,6 +987,9 @@ void WebPage::finish(bool ok)
 {
     QString status = ok ? "success" : "fail";
     emit loadFinished(status);
+
+    // Requests made by the document once loaded keep it from being idle
+    m_networkAccessManager->restartNetworkIdle();
 }
 
 void WebPage::setCustomHeaders(const QVariantMap& headers)
@@ -838,6 +1002,16 @@ QVariantMap WebPage::customHeaders() const
     return m_networkAccessManager->customHeaders();
 }
 
+void WebPage::setResourceRules(const QVariantList& rules)
+{
+    m_networkAccessManager->setResourceRules(rules);
+}
+
+QVariantList WebPage::resourceRules() const
+{
+    return m_networkAccessManager->resourceRules();
+}
+
 void WebPage::setCookieJar(CookieJar* cookieJar)
 {
     m_cookieJar = cookieJar;
@@ -895,6 +1069,7 @@ void WebPage::openUrl(const QString& address, const QVariant& op, const QVariant
 
     applySettings(settings);
     m_customWebPage->triggerAction(QWebPage::Stop);
+    m_networkAccessManager->clearNetworkTimings();
 
     if (op.type() == QVariant::String) {
         operation = op.toString();
@@ -1014,14 +1189,23 @@ bool WebPage::render(const QString& fileName, const QVariantMap& option)
         } else {
             mode = Content;
         }
-        QImage rawPageRendering = renderImage(mode);
 
-        const char* f = 0; // 0 is QImage#save default
-        if (format != "") {
-            f = format.toLocal8Bit().constData();
-        }
+        const int stripHeight = option.value("stripHeight").toInt();
+        const QString imageFormat = format.isEmpty() ? QFileInfo(outFileName).suffix() : format;
+        if (stripHeight > 0 && imageFormat.compare("png", Qt::CaseInsensitive) == 0) {
+            QFile file(outFileName);
+            retval = file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                && renderImageStrips(&file, mode, stripHeight, quality);
+        } else {
+            QImage rawPageRendering = renderImage(mode);
 
-        retval = rawPageRendering.save(outFileName, f, quality);
+            const char* f = 0; // 0 is QImage#save default
+            if (format != "") {
+                f = format.toLocal8Bit().constData();
+            }
+
+            retval = rawPageRendering.save(outFileName, f, quality);
+        }
     }
 
     if (tempFileName != "") {
@@ -1062,7 +1246,7 @@ bool WebPage::render(const QString& fileName, const QVariantMap& option)
     return retval;
 }
 
-QString WebPage::renderBase64(const QByteArray& format)
+QString WebPage::renderBase64(const QByteArray& format, const QVariantMap& option)
 {
     QByteArray nformat = format.toLower();
 
@@ -1076,29 +1260,98 @@ QString WebPage::renderBase64(const QByteArray& format)
     QBuffer buffer(&bytes);
     buffer.open(QIODevice::WriteOnly);
 
-    if (nformat == "pdf") {
-        QPdfWriter pdfWriter(&buffer);
+    if (!renderToDevice(&buffer, nformat, option)) {
+        // Return an empty string if the render fails
+        return "";
+    }
 
-        if (!renderPdf(pdfWriter)) {
-            // Return an empty string if pdf render fails
-            return "";
-        }
-    } else {
-        QImage rawPageRendering = renderImage();
+    return bytes.toBase64();
+}
+
+bool WebPage::_renderTo(QObject* target, const QVariantMap& option)
+{
+    QByteArray format = option.value("format", "png").toString().toLower().toLatin1();
 
-        // Writing image to the buffer, using PNG encoding
-        rawPageRendering.save(&buffer, nformat);
+    if (format != "pdf" && !QImageWriter::supportedImageFormats().contains(format)) {
+        qDebug() << "WebPage::renderTo - unsupported format:" << format;
+        return false;
     }
 
-    return bytes.toBase64();
+    RenderTargetDevice device(target);
+    if (!device.open(QIODevice::WriteOnly)) {
+        qDebug() << "WebPage::renderTo - unsupported target:" << target;
+        return false;
+    }
+
+    bool retval = renderToDevice(&device, format, option);
+    device.close();
+    return retval && !device.hasError();
+}
+
+bool WebPage::renderToDevice(QIODevice* device, const QByteArray& format, const QVariantMap& option)
+{
+    if (format == "pdf") {
+        QPdfWriter pdfWriter(device);
+        return renderPdf(pdfWriter);
+    }
+
+    RenderMode mode = option.value("onlyViewport").toBool() ? Viewport : Content;
+    int quality = option.contains("quality") ? option.value("quality").toInt() : -1;
+    int stripHeight = option.value("stripHeight").toInt();
+
+    if (format == "png" && stripHeight > 0) {
+        return renderImageStrips(device, mode, stripHeight, quality);
+    }
+    return renderImage(mode).save(device, format.constData(), quality);
 }
 
 QImage WebPage::renderImage(const RenderMode mode)
 {
-    QRect frameRect;
     QSize viewportSize = m_customWebPage->viewportSize();
+    QRect frameRect = prepareRenderRect(mode);
+
+    QImage buffer(frameRect.size(), renderImageFormat());
+    buffer.fill(Qt::transparent);
+    renderTiles(buffer, frameRect);
+
+    if (mode != Viewport) {
+        m_customWebPage->setViewportSize(viewportSize);
+    }
+    return buffer;
+}
+
+bool WebPage::renderImageStrips(QIODevice* device, const RenderMode mode, const int stripHeight, const int quality)
+{
+    QSize viewportSize = m_customWebPage->viewportSize();
+    QRect frameRect = prepareRenderRect(mode);
+
+    // Only one strip of the page is rasterized at any given time: as soon as
+    // it is painted it goes through the encoder and the buffer is reused for
+    // the next one. Peak memory depends on the strip height, not the page height.
+    PngStripWriter writer(device, frameRect.size(), quality);
+    QImage strip;
+    for (int top = 0; top < frameRect.height() && !writer.hasError(); top += stripHeight) {
+        const QRect stripRect(frameRect.left(), frameRect.top() + top,
+            frameRect.width(), qMin(stripHeight, frameRect.height() - top));
+        if (strip.size() != stripRect.size()) {
+            strip = QImage(stripRect.size(), renderImageFormat());
+        }
+        strip.fill(Qt::transparent);
+        renderTiles(strip, stripRect);
+        writer.writeStrip(strip);
+    }
+
+    if (mode != Viewport) {
+        m_customWebPage->setViewportSize(viewportSize);
+    }
+    return writer.finish();
+}
+
+QRect WebPage::prepareRenderRect(const RenderMode mode)
+{
+    QRect frameRect;
     if (mode == Viewport) {
-        frameRect = QRect(QPoint(0, 0), viewportSize);
+        frameRect = QRect(QPoint(0, 0), m_customWebPage->viewportSize());
     } else {
         QSize contentsSize = m_mainFrame->contentsSize();
         contentsSize -= QSize(m_scrollPosition.x(), m_scrollPosition.y());
@@ -1109,51 +1362,49 @@ QImage WebPage::renderImage(const RenderMode mode)
     if (!m_clipRect.isNull()) {
         frameRect = m_clipRect;
     }
+    return frameRect;
+}
 
+QImage::Format WebPage::renderImageFormat() const
+{
 #ifdef Q_OS_WIN
-    QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+    return QImage::Format_ARGB32_Premultiplied;
 #else
-    QImage::Format format = QImage::Format_ARGB32;
+    return QImage::Format_ARGB32;
 #endif
+}
 
-    QImage buffer(frameRect.size(), format);
-    buffer.fill(Qt::transparent);
-
+void WebPage::renderTiles(QImage& buffer, const QRect& frameRect)
+{
     QPainter painter;
 
     // We use tiling approach to work-around Qt software rasterizer bug
     // when dealing with very large paint device.
     // See http://code.google.com/p/phantomjs/issues/detail?id=54.
+    //
+    // Every tile is a QImage sharing the scanlines of the main buffer, so
+    // the page is painted straight into its final place: no tile has to be
+    // allocated and copied over afterwards. Tiles are still painted one
+    // after the other, since WebKit can only paint from the GUI thread.
     const int tileSize = 4096;
-    int htiles = (buffer.width() + tileSize - 1) / tileSize;
-    int vtiles = (buffer.height() + tileSize - 1) / tileSize;
-    for (int x = 0; x < htiles; ++x) {
-        for (int y = 0; y < vtiles; ++y) {
-
-            QImage tileBuffer(tileSize, tileSize, format);
-            tileBuffer.fill(Qt::transparent);
-
-            // Render the web page onto the small tile first
+    const int bytesPerPixel = buffer.depth() / 8;
+    for (int y = 0; y < buffer.height(); y += tileSize) {
+        for (int x = 0; x < buffer.width(); x += tileSize) {
+            const QRect tileRect = QRect(x, y, tileSize, tileSize).intersected(buffer.rect());
+            QImage tileBuffer(buffer.scanLine(tileRect.top()) + tileRect.left() * bytesPerPixel,
+                tileRect.width(), tileRect.height(), buffer.bytesPerLine(), buffer.format());
+
+            // Render only the part of the web page covered by this tile
             painter.begin(&tileBuffer);
             painter.setRenderHint(QPainter::Antialiasing, true);
             painter.setRenderHint(QPainter::TextAntialiasing, true);
             painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
             painter.translate(-frameRect.left(), -frameRect.top());
-            painter.translate(-x * tileSize, -y * tileSize);
-            m_mainFrame->render(&painter, QRegion(frameRect));
-            painter.end();
-
-            // Copy the tile to the main buffer
-            painter.begin(&buffer);
-            painter.setCompositionMode(QPainter::CompositionMode_Source);
-            painter.drawImage(x * tileSize, y * tileSize, tileBuffer);
+            painter.translate(-tileRect.left(), -tileRect.top());
+            m_mainFrame->render(&painter, QRegion(tileRect.translated(frameRect.topLeft())));
             painter.end();
         }
     }
-    if (mode != Viewport) {
-        m_customWebPage->setViewportSize(viewportSize);
-    }
-    return buffer;
 }
 
 qreal WebPage::stringToPointSize(const QString& string) const
@@ -1771,6 +2022,14 @@ void WebPage::updateLoadingProgress(int progress)
     m_loadingProgress = progress;
 }
 
+void WebPage::handleNetworkIdle()
+{
+    // The quiet time is counted again from the end of the load
+    if (!loading()) {
+        emit networkIdle();
+    }
+}
+
 void WebPage::handleRepaintRequested(const QRect& dirtyRect)
 {
     emit repaintRequested(dirtyRect.x(), dirtyRect.y(), dirtyRect.width(), dirtyRect.height());
@@ -1789,6 +2048,44 @@ void WebPage::stopJavaScript()
 void WebPage::clearMemoryCache()
 {
     QWebSettings::clearMemoryCaches();
+    MemoryCache::clearStore();
+}
+
+QVariantList WebPage::networkTimings() const
+{
+    return m_networkAccessManager->networkTimings();
+}
+
+void WebPage::clearNetworkTimings()
+{
+    m_networkAccessManager->clearNetworkTimings();
+}
+
+void WebPage::_reset()
+{
+    stop();
+    switchToMainFrame();
+    m_shouldInterruptJs = false;
+    m_navigationLocked = false;
+
+    foreach (WebPage* childPage, findChildren<WebPage*>(QString(), Qt::FindDirectChildrenOnly)) {
+        childPage->close();
+    }
+
+    // Session storage lives as long as the page: drop what the last document left
+    m_mainFrame->evaluateJavaScript("try { window.sessionStorage.clear(); } catch (e) {}");
+    m_mainFrame->setHtml(BLANK_HTML);
+    m_customWebPage->history()->clear();
+
+    m_customWebPage->setViewportSize(QSize(400, 300));
+    m_clipRect = QRect();
+    m_scrollPosition = QPoint(0, 0);
+    m_mainFrame->setScrollPosition(m_scrollPosition);
+    m_mainFrame->setZoomFactor(1.0);
+    m_paperSize = QVariantMap();
+    m_networkAccessManager->setCustomHeaders(QVariantMap());
+    m_networkAccessManager->setResourceRules(QVariantList());
+    m_networkAccessManager->clearNetworkTimings();
 }
 
 #include "webpage.moc"
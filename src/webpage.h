@@ -31,6 +31,7 @@
 #ifndef WEBPAGE_H
 #define WEBPAGE_H
 
+#include <QImage>
 #include <QMap>
 #include <QPdfWriter>
 #include <QVariantMap>
@@ -43,6 +44,7 @@ class Config;
 class CustomPage;
 class WebpageCallbacks;
 class NetworkAccessManager;
+class QIODevice;
 class QWebInspector;
 class Phantom;
 
@@ -69,6 +71,7 @@ class WebPage : public QObject {
     Q_PROPERTY(QVariantMap scrollPosition READ scrollPosition WRITE setScrollPosition)
     Q_PROPERTY(bool navigationLocked READ navigationLocked WRITE setNavigationLocked)
     Q_PROPERTY(QVariantMap customHeaders READ customHeaders WRITE setCustomHeaders)
+    Q_PROPERTY(QVariantList resourceRules READ resourceRules WRITE setResourceRules)
     Q_PROPERTY(qreal zoomFactor READ zoomFactor WRITE setZoomFactor)
     Q_PROPERTY(QVariantList cookies READ cookies WRITE setCookies)
     Q_PROPERTY(QString windowName READ windowName)
@@ -129,6 +132,9 @@ public:
     void setCustomHeaders(const QVariantMap& headers);
     QVariantMap customHeaders() const;
 
+    void setResourceRules(const QVariantList& rules);
+    QVariantList resourceRules() const;
+
     int showInspector(const int remotePort = -1);
 
     QString footer(int page, int numPages);
@@ -240,6 +246,19 @@ public slots:
     void close();
 
     QVariant evaluateJavaScript(const QString& code);
+    /**
+     * Render the page to a file.
+     *
+     * Supported options are "format", "quality" and "onlyViewport".
+     * For PNG output, "stripHeight" makes the page be rasterized and encoded
+     * in strips of that many pixels, which bounds the memory used to render
+     * very tall pages.
+     *
+     * @brief render
+     * @param fileName Path of the output file
+     * @param map Rendering options
+     * @return true if the page has been rendered successfully
+     */
     bool render(const QString& fileName, const QVariantMap& map = QVariantMap());
     /**
      * Render the page as base-64 encoded string.
@@ -249,11 +268,27 @@ public slots:
      * Available formats are the one supported by Qt QImageWriter class:
      * @link http://qt-project.org/doc/qt-4.8/qimagewriter.html#supportedImageFormats.
      *
+     * For the "png" format, the "stripHeight" option has the same meaning as for `render`.
+     *
      * @brief renderBase64
      * @param format String containing one of the supported types
+     * @param option Rendering options
      * @return Rendering base-64 encoded of the page if the given format is supported, otherwise an empty string
      */
-    QString renderBase64(const QByteArray& format = "png");
+    QString renderBase64(const QByteArray& format = "png", const QVariantMap& option = QVariantMap());
+    /**
+     * Render the page straight into @p target, which can be a File opened for writing,
+     * a WebServerResponse or a ChildProcessContext.
+     * The encoded bytes are written as they are: no base64 or string conversion happens.
+     *
+     * Supported options are the ones of `render`; "format" defaults to "png".
+     *
+     * @brief _renderTo
+     * @param target Object the rendering is written to
+     * @param option Rendering options
+     * @return true if the page has been rendered and written successfully
+     */
+    bool _renderTo(QObject* target, const QVariantMap& option);
     bool injectJs(const QString& jsFilePath);
     void _appendScriptElement(const QString& scriptUrl);
     QObject* _getGenericCallback();
@@ -482,6 +517,33 @@ public slots:
 
     void clearMemoryCache();
 
+    /**
+     * Timings of the requests the page made since it last started loading
+     * a URL, one HAR-like entry per finished request.
+     *
+     * @brief networkTimings
+     * @return List of {id, url, method, status, startedDateTime, time, timings}
+     */
+    QVariantList networkTimings() const;
+    void clearNetworkTimings();
+
+    /**
+     * Bring the page back to the state of a newly created one, so that it
+     * can be reused instead of creating a new page.
+     *
+     * Loading and JavaScript are stopped, the main frame is selected again,
+     * the child pages are closed, the session storage and the navigation
+     * history are cleared and a blank document is loaded.
+     * Viewport size, clip rect, scroll position, zoom factor, paper size,
+     * custom headers and resource rules get their default values back.
+     *
+     * NOTE: Cookies and local storage are not per page but shared with
+     * the other pages using the same cookie jar and storage path.
+     *
+     * @brief _reset
+     */
+    void _reset();
+
     void setProxy(const QString& proxyUrl);
 
     qreal stringToPointSize(const QString&) const;
@@ -504,12 +566,22 @@ signals:
     void rawPageCreated(QObject* page);
     void closing(QObject* page);
     void repaintRequested(const int x, const int y, const int width, const int height);
+    /**
+     * The page is loaded and has made no more than the "networkIdleMaxInflight"
+     * setting of requests for "networkIdleTime" milliseconds since.
+     */
+    void networkIdle();
+
+protected:
+    void connectNotify(const QMetaMethod& signal);
+    void disconnectNotify(const QMetaMethod& signal);
 
 private slots:
     void finish(bool ok);
     void setupFrame(QWebFrame* frame = Q_NULLPTR);
     void updateLoadingProgress(int progress);
     void handleRepaintRequested(const QRect& dirtyRect);
+    void handleNetworkIdle();
     void handleUrlChanged(const QUrl& url);
     void handleCurrentFrameDestroyed();
 
@@ -517,9 +589,15 @@ private:
     enum RenderMode { Content,
         Viewport };
     QImage renderImage(const RenderMode mode = Content);
+    bool renderToDevice(QIODevice* device, const QByteArray& format, const QVariantMap& option);
+    bool renderImageStrips(QIODevice* device, const RenderMode mode, const int stripHeight, const int quality = -1);
+    QRect prepareRenderRect(const RenderMode mode);
+    QImage::Format renderImageFormat() const;
+    void renderTiles(QImage& buffer, const QRect& frameRect);
     bool renderPdf(QPdfWriter& pdfWriter);
     void applySettings(const QVariantMap& defaultSettings);
     QString userAgent() const;
+    void updateReportedResourceSignals();
 
     /**
      * Switches focus from the Current Frame to the Child Frame, identified by `frame`.
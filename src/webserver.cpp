@@ -39,10 +39,17 @@
 #include <QDebug>
 #include <QHostAddress>
 #include <QMetaType>
+#include <QTextCodec>
+#include <QTextDecoder>
 #include <QThread>
 #include <QUrl>
 #include <QVector>
 
+// Request bodies are read from the connection in pieces of this size
+#define BODY_CHUNK_SIZE (64 * 1024)
+
+const char* responseCodeString(int code);
+
 namespace UrlEncodedParser {
 
 QString unescape(QByteArray in)
@@ -80,6 +87,17 @@ QVariantMap parse(const QByteArray& data)
 }
 }
 
+// The body of the request may be left unread, the connection can not be kept alive
+static void sendErrorResponse(mg_connection* conn, int code)
+{
+    mg_printf(conn,
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n\r\n",
+        code, responseCodeString(code));
+    mg_close_after_request(conn);
+}
+
 static void* callback(mg_event event,
     mg_connection* conn,
     const mg_request_info* request)
@@ -96,6 +114,9 @@ static void* callback(mg_event event,
 WebServer::WebServer(QObject* parent)
     : QObject(parent)
     , m_ctx(0)
+    , m_maxPendingRequests(0)
+    , m_maxBodySize(0)
+    , m_streamBody(false)
 {
     setObjectName("WebServer");
     qRegisterMetaType<WebServerResponse*>("WebServerResponse*");
@@ -119,8 +140,20 @@ bool WebServer::listenOnPort(const QString& port, const QVariantMap& opts)
         options << "enable_keep_alive"
                 << "yes";
     }
+    const QByteArray numThreads = QByteArray::number(opts.value("numThreads", 0).toInt());
+    if (numThreads.toInt() > 0) {
+        options << "num_threads" << numThreads.constData();
+    }
+    const QByteArray queueSize = QByteArray::number(opts.value("queueSize", 0).toInt());
+    if (queueSize.toInt() > 0) {
+        options << "socket_queue_size" << queueSize.constData();
+    }
     options << 0;
 
+    m_maxPendingRequests = qMax(0, opts.value("maxPendingRequests", 0).toInt());
+    m_maxBodySize = qMax(Q_INT64_C(0), opts.value("maxBodySize", 0).toLongLong());
+    m_streamBody = opts.value("streamBody", false).toBool();
+
     // Start the server
     m_ctx = mg_start(&callback, this, options.data());
     if (!m_ctx) {
@@ -146,6 +179,7 @@ void WebServer::close()
             QMutexLocker lock(&m_mutex);
             foreach (WebServerResponse* response, m_pendingResponses) {
                 response->close();
+                response->abortBody();
             }
         }
         mg_stop(m_ctx);
@@ -164,6 +198,29 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
         return false;
     }
 
+    // Register the response before doing any work on the request,
+    // so that the pending requests limit is checked atomically.
+    QSemaphore wait;
+    QSemaphore bodyStart;
+    WebServerResponse responseObject(conn, &wait, m_streamBody ? &bodyStart : Q_NULLPTR);
+    responseObject.moveToThread(thread());
+
+    {
+        QMutexLocker lock(&m_mutex);
+        if (m_closing.loadAcquire()) {
+            return false;
+        }
+        if (m_maxPendingRequests > 0 && m_pendingResponses.size() >= m_maxPendingRequests) {
+            lock.unlock();
+            // Shed load right here, in the worker thread: the script is not
+            // keeping up, queueing more work for it would only make it worse.
+            qDebug() << "HTTP Request - Too many pending requests, rejecting" << request->uri;
+            sendErrorResponse(conn, 503);
+            return true;
+        }
+        m_pendingResponses << (&responseObject);
+    }
+
     // Modelled after http://nodejs.org/docs/latest/api/http.html#http.ServerRequest
     QVariantMap requestObject;
 
@@ -233,35 +290,52 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
     }
     requestObject["headers"] = headersObject;
 
-    // Read request body ONLY for POST and PUT, and ONLY if the "Content-Length" is provided
-    if ((requestObject["method"] == "POST" || requestObject["method"] == "PUT") && ciHeadersObject.contains(HTTP_HEADER_CONTENT_LENGTH)) {
-        bool contentLengthKnown = false;
-        uint contentLength = ciHeadersObject[HTTP_HEADER_CONTENT_LENGTH].toUInt(&contentLengthKnown);
+    // Refuse bodies we know upfront to be too large, before reading anything
+    const bool chunked = ciHeadersObject.value(HTTP_HEADER_TRANSFER_ENCODING).compare("chunked", Qt::CaseInsensitive) == 0;
+    bool contentLengthKnown = false;
+    const qint64 contentLength = ciHeadersObject.value(HTTP_HEADER_CONTENT_LENGTH).toLongLong(&contentLengthKnown);
+    if (m_maxBodySize > 0 && !chunked && contentLengthKnown && contentLength > m_maxBodySize) {
+        qWarning() << "HTTP Request - Content-Length" << contentLength << "exceeds" << m_maxBodySize << "bytes";
+        sendErrorResponse(conn, 413);
+        removePendingResponse(&responseObject);
+        return true;
+    }
 
+    // Read request body ONLY for POST and PUT, and ONLY if the "Content-Length"
+    // is provided or the body is chunked. When bodies are streamed, this
+    // happens once the script has had a chance to listen for them.
+    if (!m_streamBody && (requestObject["method"] == "POST" || requestObject["method"] == "PUT") && (chunked || ciHeadersObject.contains(HTTP_HEADER_CONTENT_LENGTH))) {
         qDebug() << "HTTP Request - Method POST/PUT";
 
         // Proceed only if we were able to read the "Content-Length"
-        if (contentLengthKnown) {
-            ++contentLength; //< make space for null termination
-            char* data = new char[contentLength];
-            int read = mg_read(conn, data, contentLength);
-            data[read] = '\0'; //< adding null termination (no arm if it's already there)
+        if (chunked || contentLengthKnown) {
+            QByteArray body;
+            const int status = readRequestBody(conn, &body);
+            if (status != 0) {
+                sendErrorResponse(conn, status);
+                removePendingResponse(&responseObject);
+                return true;
+            }
 
-            qDebug() << "HTTP Request - Content Body:" << qPrintable(data);
+            qDebug() << "HTTP Request - Content Body:" << body;
 
             // Check if the 'Content-Type' requires decoding
             if (ciHeadersObject[HTTP_HEADER_CONTENT_TYPE] == "application/x-www-form-urlencoded") {
-                requestObject["post"] = UrlEncodedParser::parse(QByteArray(data, read));
-                requestObject["postRaw"] = QString::fromUtf8(data, read);
+                requestObject["post"] = UrlEncodedParser::parse(body);
+                requestObject["postRaw"] = QString::fromUtf8(body);
             } else {
-                requestObject["post"] = QString::fromUtf8(data, read);
+                requestObject["post"] = QString::fromUtf8(body);
             }
-            delete[] data;
         } else {
             qWarning() << "HTTP Request - Malformed 'Content-Length'";
         }
     }
 
+    if (m_closing.loadAcquire()) {
+        removePendingResponse(&responseObject);
+        return false;
+    }
+
     // Emit signal that is catched by the PhantomJS callback,
     // then wait until response.close() was called from
     // the PhantomJS script.
@@ -269,21 +343,17 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
     // This is achieved using the wait semaphore, which is
     // acquired here, in the background thread, and released
     // in WebServerResponse::close() i.e. the foreground thread
-    QSemaphore wait;
-    WebServerResponse responseObject(conn, &wait);
-    responseObject.moveToThread(thread());
-
-    {
-        if (m_closing.loadAcquire()) {
-            return false;
-        }
-        QMutexLocker lock(&m_mutex);
-        if (m_closing.loadAcquire()) {
-            return false;
+    newRequest(requestObject, &responseObject);
+    if (m_streamBody) {
+        // The script connects to the body signals from within its request
+        // handler: only start reading once that handler has returned,
+        // which is when the queued startBody() call gets delivered.
+        QMetaObject::invokeMethod(&responseObject, "startBody", Qt::QueuedConnection);
+        bodyStart.acquire();
+        if (!m_closing.loadAcquire()) {
+            streamRequestBody(conn, &responseObject);
         }
-        m_pendingResponses << (&responseObject);
     }
-    newRequest(requestObject, &responseObject);
     wait.acquire();
     {
         if (m_closing.loadAcquire()) {
@@ -298,14 +368,81 @@ bool WebServer::handleRequest(mg_event event, mg_connection* conn, const mg_requ
     return true;
 }
 
+int WebServer::readRequestBody(mg_connection* conn, QByteArray* body)
+{
+    // Grow the body as data actually arrives, rather than trusting
+    // whatever size the client announced
+    int size = 0;
+    int read;
+    do {
+        body->resize(size + BODY_CHUNK_SIZE);
+        read = mg_read(conn, body->data() + size, BODY_CHUNK_SIZE);
+        if (read > 0) {
+            size += read;
+        }
+        if (m_maxBodySize > 0 && size > m_maxBodySize) {
+            qWarning() << "HTTP Request - Body exceeds" << m_maxBodySize << "bytes";
+            body->clear();
+            return 413;
+        }
+    } while (read > 0);
+
+    // The connection broke, or the chunks are malformed
+    if (read < 0) {
+        qWarning() << "HTTP Request - Body could not be read";
+        body->clear();
+        return 400;
+    }
+    body->resize(size);
+    return 0;
+}
+
+void WebServer::streamRequestBody(mg_connection* conn, WebServerResponse* response)
+{
+    // Keeps multi-byte sequences split across two pieces intact
+    QTextDecoder decoder(QTextCodec::codecForName("UTF-8"));
+    QByteArray buffer(BODY_CHUNK_SIZE, Qt::Uninitialized);
+    qint64 size = 0;
+    int read = -1;
+    while (!response->isClosed() && !m_closing.loadAcquire()
+        && (read = mg_read(conn, buffer.data(), buffer.size())) > 0) {
+        size += read;
+        if (m_maxBodySize > 0 && size > m_maxBodySize) {
+            qWarning() << "HTTP Request - Body exceeds" << m_maxBodySize << "bytes";
+            mg_close_after_request(conn);
+            emit response->bodyError("Request body too large");
+            return;
+        }
+        emit response->bodyData(decoder.toUnicode(buffer.constData(), read));
+    }
+
+    // mg_read() gives 0 at the end of the body, and less on errors
+    if (read == 0) {
+        emit response->bodyEnd();
+        return;
+    }
+    // Stopped before the end: the rest of the body is not read
+    mg_close_after_request(conn);
+    emit response->bodyError(response->isClosed() || m_closing.loadAcquire()
+        ? "Request body not read to its end" : "Request body could not be read");
+}
+
+void WebServer::removePendingResponse(WebServerResponse* response)
+{
+    QMutexLocker lock(&m_mutex);
+    m_pendingResponses.removeOne(response);
+}
+
 //BEGIN WebServerResponse
 
-WebServerResponse::WebServerResponse(mg_connection* conn, QSemaphore* close)
+WebServerResponse::WebServerResponse(mg_connection* conn, QSemaphore* close, QSemaphore* bodyStart)
     : QObject()
     , m_conn(conn)
     , m_statusCode(200)
     , m_headersSent(false)
+    , m_chunked(false)
     , m_close(close)
+    , m_bodyStart(bodyStart)
 {
 }
 
@@ -406,47 +543,105 @@ void WebServerResponse::writeHead(int statusCode, const QVariantMap& headers)
     Q_ASSERT(!m_headersSent);
     m_headersSent = true;
     m_statusCode = statusCode;
-    mg_printf(m_conn, "HTTP/1.1 %d %s\r\n", m_statusCode, responseCodeString(m_statusCode));
+    m_pendingHead = "HTTP/1.1 " + QByteArray::number(m_statusCode) + ' ' + responseCodeString(m_statusCode) + "\r\n";
     qDebug() << "HTTP Response - Status Code" << m_statusCode << responseCodeString(m_statusCode);
     QVariantMap::const_iterator it = headers.constBegin();
     while (it != headers.constEnd()) {
-        qDebug() << "HTTP Response - Sending Header" << it.key() << "=" << it.value().toString();
-        mg_printf(m_conn, "%s: %s\r\n", qPrintable(it.key()), qPrintable(it.value().toString()));
+        const QString value = it.value().toString();
+        qDebug() << "HTTP Response - Sending Header" << it.key() << "=" << value;
+        m_pendingHead += it.key().toLocal8Bit() + ": " + value.toLocal8Bit() + "\r\n";
+        if (it.key().compare(HTTP_HEADER_TRANSFER_ENCODING, Qt::CaseInsensitive) == 0
+            && value.contains("chunked", Qt::CaseInsensitive)) {
+            m_chunked = true;
+        }
         ++it;
     }
-    mg_write(m_conn, "\r\n", 2);
+    m_pendingHead += "\r\n";
 }
 
 void WebServerResponse::write(const QVariant& body)
 {
-    if (!m_headersSent) {
-        writeHead(m_statusCode, m_headers);
-    }
-
     QByteArray data;
     if (m_encoding.isEmpty()) {
         data = body.toString().toUtf8();
-    } else if (m_encoding.toLower() == "binary") {
+    } else if (m_encoding == "binary") {
         data = body.toString().toLatin1();
     } else {
-        Encoding encoding;
-        encoding.setEncoding(m_encoding);
-        data = encoding.encode(body.toString());
+        data = m_codec.encode(body.toString());
+    }
+
+    writeBytes(data);
+}
+
+void WebServerResponse::flush()
+{
+    writeBytes(QByteArray());
+}
+
+bool WebServerResponse::writeBytes(const QByteArray& bytes)
+{
+    if (!m_headersSent) {
+        writeHead(m_statusCode, m_headers);
+    }
+
+    // Everything goes out in a single write: the head, the chunk
+    // framing and the data. Separate small writes would be held
+    // back by Nagle's algorithm.
+    QByteArray out;
+    out.swap(m_pendingHead);
+    if (m_chunked) {
+        // An empty chunk would terminate the body
+        if (!bytes.isEmpty()) {
+            out += QByteArray::number(bytes.size(), 16) + "\r\n" + bytes + "\r\n";
+        }
+    } else if (out.isEmpty()) {
+        return sendBytes(bytes);
+    } else {
+        out += bytes;
     }
+    return sendBytes(out);
+}
 
-    mg_write(m_conn, data.constData(), data.size());
+bool WebServerResponse::sendBytes(const QByteArray& bytes)
+{
+    if (bytes.isEmpty()) {
+        return true;
+    }
+    return mg_write(m_conn, bytes.constData(), bytes.size()) == bytes.size();
 }
 
 void WebServerResponse::setEncoding(const QString& encoding)
 {
-    m_encoding = encoding;
+    m_encoding = encoding.toLower() == "binary" ? QString("binary") : encoding;
+    m_codec.setEncoding(encoding);
 }
 
 void WebServerResponse::close()
 {
+    if (m_closed.testAndSetOrdered(0, 1) && m_headersSent) {
+        // Send what is left of the head, and end the chunked body
+        QByteArray out;
+        out.swap(m_pendingHead);
+        if (m_chunked) {
+            out += "0\r\n\r\n";
+        }
+        sendBytes(out);
+    }
     m_close->release();
 }
 
+bool WebServerResponse::isClosed() const
+{
+    return m_closed.loadAcquire();
+}
+
+void WebServerResponse::abortBody()
+{
+    if (m_bodyStart) {
+        m_bodyStart->release();
+    }
+}
+
 void WebServerResponse::closeGracefully()
 {
     write("");
@@ -489,4 +684,13 @@ void WebServerResponse::setHeaders(const QVariantMap& headers)
     m_headers = headers;
 }
 
+// private slots:
+
+void WebServerResponse::startBody()
+{
+    if (m_bodyStart) {
+        m_bodyStart->release();
+    }
+}
+
 //END WebServerResponse
@@ -35,6 +35,7 @@
 #include <QSemaphore>
 #include <QVariantMap>
 
+#include "encoding.h"
 #include "mongoose.h"
 
 class Config;
@@ -61,6 +62,19 @@ public slots:
      * For each new request @c handleRequest() will be called which
      * in turn emits @c newRequest() where appropriate.
      *
+     * Supported @p options:
+     *  - keepAlive: keep connections open between requests (default false)
+     *  - numThreads: number of worker threads serving connections (default 10)
+     *  - queueSize: number of accepted connections waiting for a free worker
+     *    thread, beyond which new connections are left in the listen backlog (default 20)
+     *  - maxPendingRequests: number of requests that may be waiting for their
+     *    response at the same time; requests beyond this limit are answered
+     *    right away with "503 Service Unavailable" (default 0, no limit)
+     *  - maxBodySize: largest request body accepted, in bytes; bigger requests
+     *    are answered with "413 Request Entity Too Large" (default 0, no limit)
+     *  - streamBody: do not buffer request bodies in request.post, deliver
+     *    them piece by piece through request.on('data') instead (default false)
+     *
      * @return true if we can listen on @p port, false otherwise.
      *
      * WARNING: must not be the same name as in the javascript api...
@@ -83,10 +97,18 @@ public:
     bool handleRequest(mg_event event, mg_connection* conn, const mg_request_info* request);
 
 private:
+    // @return 0 once the whole body is read, else the status to reply with
+    int readRequestBody(mg_connection* conn, QByteArray* body);
+    void streamRequestBody(mg_connection* conn, WebServerResponse* response);
+    void removePendingResponse(WebServerResponse* response);
+
     mg_context* m_ctx;
     QString m_port;
     QMutex m_mutex;
     QList<WebServerResponse*> m_pendingResponses;
+    int m_maxPendingRequests;
+    qint64 m_maxBodySize;
+    bool m_streamBody;
     QAtomicInt m_closing;
 };
 
@@ -99,13 +121,23 @@ class WebServerResponse : public QObject {
     Q_PROPERTY(int statusCode READ statusCode WRITE setStatusCode)
     Q_PROPERTY(QVariantMap headers READ headers WRITE setHeaders)
 public:
-    WebServerResponse(mg_connection* conn, QSemaphore* close);
+    /// @p bodyStart, when set, is released once the script is ready to receive the request body
+    WebServerResponse(mg_connection* conn, QSemaphore* close, QSemaphore* bodyStart = Q_NULLPTR);
 
 public slots:
-    /// send @p headers to client with status code @p statusCode
+    /**
+     * Set the status code and @p headers of the response.
+     *
+     * The head goes out together with the first piece of data written,
+     * or on flush() or close(), whichever comes first.
+     * With a "Transfer-Encoding: chunked" header, every write() is sent
+     * as a separate chunk and close() sends the terminating chunk.
+     */
     void writeHead(int statusCode, const QVariantMap& headers);
     /// sends @p data to client and makes sure the headers are send beforehand
     void write(const QVariant& data);
+    /// sends the response head to the client now, if it has not been sent yet
+    void flush();
     // sets @p as encoding used to output data
     void setEncoding(const QString& encoding);
 
@@ -139,13 +171,40 @@ public slots:
     /// set all headers
     void setHeaders(const QVariantMap& headers);
 
+public:
+    /// sends @p bytes to client as they are, making sure the headers are send beforehand
+    bool writeBytes(const QByteArray& bytes);
+
+    /// whether close() has been called, safe to use from any thread
+    bool isClosed() const;
+    /// stop waiting for the script to receive the request body
+    void abortBody();
+
+signals:
+    /// a piece of the request body, only when the server streams request bodies
+    void bodyData(const QString& chunk);
+    /// the request body has been received completely
+    void bodyEnd();
+    /// the request body could not be received
+    void bodyError(const QString& message);
+
+private slots:
+    void startBody();
+
 private:
+    bool sendBytes(const QByteArray& bytes);
+
     mg_connection* m_conn;
     int m_statusCode;
     QVariantMap m_headers;
     bool m_headersSent;
+    bool m_chunked;
+    QByteArray m_pendingHead;
     QString m_encoding;
+    Encoding m_codec;
     QSemaphore* m_close;
+    QSemaphore* m_bodyStart;
+    QAtomicInt m_closed;
 };
 
 #endif // WEBSERVER_H
@@ -0,0 +1,22 @@
+var system = require('system');
+var page = require('webpage').create();
+
+// Prints the load status, and title if loaded, of each page given, one per line,
+// followed by a line for each of its cookies
+var urls = system.args.slice(1);
+
+function next() {
+    if (urls.length === 0) {
+        phantom.exit(0);
+        return;
+    }
+    page.open(urls.shift(), function (status) {
+        console.log(status === 'success' ? status + ' ' + page.title : status);
+        page.cookies.forEach(function (cookie) {
+            console.log('cookie ' + cookie.name + '=' + cookie.value);
+        });
+        next();
+    });
+}
+
+next();
@@ -0,0 +1,16 @@
+var system = require('system');
+
+require('supervisor').serve(function (job, done) {
+    switch (job.op) {
+    case 'echo':
+        setTimeout(function () {
+            done(null, { value: job.value, pid: system.pid });
+        }, 10);
+        break;
+    case 'fail':
+        throw new Error(job.message);
+    case 'exit':
+        phantom.exit(3);
+        break;
+    }
+});
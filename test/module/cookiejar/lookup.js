@@ -0,0 +1,63 @@
+var cookiejar = require('cookiejar');
+
+function add(jar, name, domain, path, secure) {
+    return jar.addCookie({
+        'name':     name,
+        'value':    'v',
+        'domain':   domain,
+        'path':     path,
+        'httponly': false,
+        'secure':   !!secure,
+        'expires':  new Date().getTime() + 3600 * 1000
+    });
+}
+
+function namesFor(jar, url) {
+    return jar.cookiesToMap(url).map(function (c) { return c.name; }).sort().join(',');
+}
+
+test(function () {
+    var jar = cookiejar.create();
+    add(jar, 'wide', '.example.com', '/');
+    add(jar, 'sub', '.b.example.com', '/');
+    add(jar, 'other', '.example.org', '/');
+
+    assert_equals(namesFor(jar, 'http://example.com/'), 'wide');
+    assert_equals(namesFor(jar, 'http://a.b.example.com/'), 'sub,wide');
+    assert_equals(namesFor(jar, 'http://notexample.com/'), '');
+}, "cookies are found for their domain and its subdomains");
+
+test(function () {
+    var jar = cookiejar.create();
+    add(jar, 'root', '.example.com', '/');
+    add(jar, 'foo', '.example.com', '/foo');
+    add(jar, 'secure', '.example.com', '/', true);
+
+    assert_equals(namesFor(jar, 'http://example.com/foobar'), 'root');
+    assert_equals(namesFor(jar, 'http://example.com/foo/bar'), 'foo,root');
+    assert_equals(namesFor(jar, 'https://example.com/'), 'root,secure');
+}, "cookies are found for their path and only over https when secure");
+
+test(function () {
+    var jar = cookiejar.create();
+    for (var i = 0; i < 2000; ++i) {
+        add(jar, 'c' + i, '.host' + i + '.example.com', '/');
+    }
+    assert_equals(jar.cookies.length, 2000);
+    assert_equals(namesFor(jar, 'http://www.host1234.example.com/'), 'c1234');
+
+    assert_is_true(jar.deleteCookie('c1234'));
+    assert_equals(namesFor(jar, 'http://www.host1234.example.com/'), '');
+    assert_equals(jar.cookies.length, 1999);
+}, "lookups and deletions in a jar with many domains");
+
+test(function () {
+    var jar = cookiejar.create();
+    add(jar, 'first', '.example.com', '/');
+    add(jar, 'second', '.example.net', '/');
+    add(jar, 'third', '.example.com', '/x');
+
+    var all = jar.cookies.map(function (c) { return c.name; });
+    assert_equals(all.length, 3);
+    assert_equals(all.sort().join(','), 'first,second,third');
+}, "all cookies are listed across domains");
@@ -0,0 +1,76 @@
+var fs = require('fs');
+var cookiejar = require('cookiejar');
+
+var COOKIES_FILE = 'cookies-01.test',
+    SESSION_COOKIES_FILE = 'cookies-02.test';
+
+function cookie(name, value) {
+    return {
+        'name':     name,
+        'value':    value,
+        'domain':   'localhost',
+        'path':     '/',
+        'httponly': false,
+        'secure':   false,
+        'expires':  new Date().getTime() + 3600 * 1000
+    };
+}
+
+function names(jar) {
+    return jar.cookies.map(function (c) { return c.name + '=' + c.value; }).sort().join(',');
+}
+
+// Jars write their changes when closed, which happens asynchronously
+function closeThen(jar, fn) {
+    jar.close();
+    setTimeout(fn, 100);
+}
+
+setup(function () {
+    [COOKIES_FILE, SESSION_COOKIES_FILE].forEach(function (file) {
+        if (fs.exists(file)) {
+            fs.remove(file);
+        }
+    });
+});
+
+async_test(function () {
+    var jar = cookiejar.create(COOKIES_FILE);
+    jar.addCookie(cookie('a', '1'));
+    jar.addCookie(cookie('b', '2'));
+    jar.addCookie(cookie('a', '3'));
+    jar.deleteCookie('b');
+
+    closeThen(jar, this.step_func(function () {
+        assert_is_true(fs.exists(COOKIES_FILE));
+        assert_equals(fs.read(COOKIES_FILE).split('\n')[0], '# PhantomJS cookie log 1');
+
+        var reopened = cookiejar.create(COOKIES_FILE);
+        assert_equals(names(reopened), 'a=3');
+
+        reopened.addCookie(cookie('c', '4'));
+        closeThen(reopened, this.step_func_done(function () {
+            var again = cookiejar.create(COOKIES_FILE);
+            assert_equals(names(again), 'a=3,c=4');
+            again.close();
+            fs.remove(COOKIES_FILE);
+        }));
+    }));
+
+}, "changes are saved to the cookies file and found again");
+
+async_test(function () {
+    var jar = cookiejar.create(SESSION_COOKIES_FILE);
+    var session = cookie('session', 'x');
+    delete session.expires;
+    jar.addCookie(session);
+    jar.addCookie(cookie('persistent', 'y'));
+
+    closeThen(jar, this.step_func_done(function () {
+        var reopened = cookiejar.create(SESSION_COOKIES_FILE);
+        assert_equals(names(reopened), 'persistent=y');
+        reopened.close();
+        fs.remove(SESSION_COOKIES_FILE);
+    }));
+
+}, "session cookies are not kept across jars");
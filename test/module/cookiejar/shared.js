@@ -0,0 +1,59 @@
+var fs = require('fs');
+var cookiejar = require('cookiejar');
+
+var COOKIES_FILE = 'cookies-03.test';
+
+function cookie(name, value, session) {
+    var c = {
+        'name':     name,
+        'value':    value,
+        'domain':   'localhost',
+        'path':     '/',
+        'httponly': false,
+        'secure':   false
+    };
+    if (!session) {
+        c.expires = new Date().getTime() + 3600 * 1000;
+    }
+    return c;
+}
+
+function names(jar) {
+    return jar.cookies.map(function (c) { return c.name + '=' + c.value; }).sort().join(',');
+}
+
+// Jars write their changes when closed, asynchronously, and pick up
+// those of the others at most every quarter of a second
+function closeThen(jar, fn) {
+    jar.close();
+    setTimeout(fn, 400);
+}
+
+setup(function () {
+    if (fs.exists(COOKIES_FILE)) {
+        fs.remove(COOKIES_FILE);
+    }
+});
+
+async_test(function () {
+    var first = cookiejar.create(COOKIES_FILE);
+    var second = cookiejar.create(COOKIES_FILE);
+    assert_equals(names(second), '');
+
+    first.addCookie(cookie('login', 'x', true));
+    first.addCookie(cookie('pref', 'y'));
+
+    closeThen(first, this.step_func(function () {
+        // The session lives on while another jar uses the file
+        assert_equals(names(second), 'login=x,pref=y');
+
+        second.addCookie(cookie('pref', 'z'));
+        closeThen(second, this.step_func_done(function () {
+            var last = cookiejar.create(COOKIES_FILE);
+            assert_equals(names(last), 'pref=z');
+            last.close();
+            fs.remove(COOKIES_FILE);
+        }));
+    }));
+
+}, "jars sharing a file see each other's changes");
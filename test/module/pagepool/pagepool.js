@@ -0,0 +1,101 @@
+var pagepool = require('pagepool');
+
+async_test(function () {
+    var pool = pagepool.create({ size: 2 });
+    var running = 0, maxRunning = 0, results = [];
+
+    function job(n) {
+        return function (page, done) {
+            running += 1;
+            maxRunning = Math.max(maxRunning, running);
+            setTimeout(function () {
+                running -= 1;
+                done(null, n);
+            }, 20);
+        };
+    }
+
+    var collect = this.step_func(function (err, result) {
+        assert_equals(err, null);
+        results.push(result);
+        if (results.length === 5) {
+            assert_equals(maxRunning, 2);
+            assert_equals(results.sort().join(','), '0,1,2,3,4');
+            assert_equals(pool.pending, 0);
+            pool.close();
+            this.done();
+        }
+    });
+
+    for (var i = 0; i < 5; i += 1) {
+        pool.run(job(i), collect);
+    }
+    assert_equals(pool.active, 2);
+    assert_equals(pool.pending, 3);
+
+}, "jobs are queued and run with the configured concurrency");
+
+async_test(function () {
+    var pool = pagepool.create({ size: 1 });
+    var url = TEST_HTTP_BASE + "hello.html";
+
+    pool.run(this.step_func(function (page, done) {
+        page.onConsoleMessage = function () {};
+        page.customHeaders = { 'X-Test': 'yes' };
+        page.cookieJar.addCookie({
+            name: 'pool', value: 'yes', domain: 'localhost', path: '/'
+        });
+        page.open(url, function (status) {
+            assert_equals(status, 'success');
+            done(null, page);
+        });
+    }), this.step_func(function (err, firstPage) {
+        assert_equals(err, null);
+        pool.run(this.step_func(function (page, done) {
+            assert_equals(page, firstPage);
+            assert_equals(page.url, 'about:blank');
+            assert_equals(page.plainText, '');
+            assert_equals(page.onConsoleMessage, undefined);
+            assert_equals(page.cookieJar.cookies.length, 0);
+            assert_no_property(page.customHeaders, 'X-Test');
+            assert_equals(page.canGoBack, false);
+            done();
+        }), this.step_func_done(function (err) {
+            assert_equals(err, null);
+            pool.close();
+        }));
+    }));
+
+}, "pages are reset between jobs");
+
+async_test(function () {
+    var pool = pagepool.create({ size: 1, timeout: 100 });
+    var lateDone;
+
+    pool.run(function (page, done) {
+        lateDone = done;
+    }, this.step_func(function (err) {
+        assert_equals(err.message, 'timeout');
+        pool.run(this.step_func(function (page, done) {
+            lateDone(null, 'late');
+            done(null, 'next');
+        }), this.step_func_done(function (err, result) {
+            assert_equals(err, null);
+            assert_equals(result, 'next');
+            pool.close();
+        }));
+    }));
+
+}, "jobs that do not finish in time fail and their page is replaced");
+
+async_test(function () {
+    var pool = pagepool.create();
+
+    pool.run(function () {
+        throw new Error('broken job');
+    }, this.step_func_done(function (err) {
+        assert_equals(err.message, 'broken job');
+        pool.close();
+    }));
+
+}, "errors thrown by a job are passed to its callback");
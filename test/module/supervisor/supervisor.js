@@ -0,0 +1,85 @@
+var fs = require('fs');
+var supervisor = require('supervisor');
+
+var WORKER_SCRIPT = fs.join(TEST_DIR, 'lib', 'fixtures', 'supervisor-worker.js');
+
+setup({ test_timeout: 20000 });
+
+test(function () {
+    var system = require('system');
+    assert_type_of(system.executablePath, 'string');
+    assert_greater_than(system.residentSetSize, 0);
+}, "system.executablePath and system.residentSetSize");
+
+async_test(function () {
+    var farm = supervisor.create({ script: WORKER_SCRIPT, workers: 2 });
+    var results = [];
+
+    var collect = this.step_func(function (err, result) {
+        assert_equals(err, null);
+        results.push(result);
+        if (results.length === 6) {
+            var values = results.map(function (r) { return r.value; });
+            var pids = {};
+            results.forEach(function (r) { pids[r.pid] = true; });
+            assert_equals(values.sort().join(','), '0,1,2,3,4,5');
+            assert_equals(Object.keys(pids).length, 2);
+            farm.close();
+            this.done();
+        }
+    });
+
+    assert_equals(farm.workers.length, 2);
+    for (var i = 0; i < 6; i += 1) {
+        farm.run({ op: 'echo', value: i }, collect);
+    }
+
+}, "jobs are spread over the worker processes");
+
+async_test(function () {
+    var farm = supervisor.create({ script: WORKER_SCRIPT, maxJobs: 2 });
+    var pids = [];
+
+    var collect = this.step_func(function (err, result) {
+        assert_equals(err, null);
+        pids.push(result.pid);
+        if (pids.length === 4) {
+            assert_equals(pids[0], pids[1]);
+            assert_not_equals(pids[1], pids[2]);
+            assert_equals(pids[2], pids[3]);
+            farm.close();
+            this.done();
+        }
+    });
+
+    for (var i = 0; i < 4; i += 1) {
+        farm.run({ op: 'echo', value: i }, collect);
+    }
+
+}, "workers are recycled after maxJobs jobs");
+
+async_test(function () {
+    var farm = supervisor.create({ script: WORKER_SCRIPT, restartDelay: 0 });
+    var exits = [];
+
+    farm.onWorkerExit = function (info) {
+        exits.push(info);
+    };
+
+    farm.run({ op: 'fail', message: 'bad job' }, this.step_func(function (err) {
+        assert_equals(err.message, 'bad job');
+    }));
+    farm.run({ op: 'exit' }, this.step_func(function (err) {
+        assert_regexp_match(err.message, /^Worker exited/);
+        assert_equals(exits.length, 1);
+        assert_equals(exits[0].code, 3);
+        assert_equals(exits[0].recycled, false);
+    }));
+    farm.run({ op: 'echo', value: 'after' }, this.step_func_done(function (err, result) {
+        assert_equals(err, null);
+        assert_equals(result.value, 'after');
+        assert_not_equals(result.pid, exits[0].pid);
+        farm.close();
+    }));
+
+}, "failed jobs report errors and dead workers are replaced");
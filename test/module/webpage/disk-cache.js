@@ -0,0 +1,43 @@
+//! phantomjs: --disk-cache=yes --disk-cache-path=disk-cache.test
+"use strict";
+
+var fs = require('fs');
+var CACHE_DIR = 'disk-cache.test';
+
+function countFiles(dir) {
+    if (!fs.isDirectory(dir)) {
+        return 0;
+    }
+    return fs.list(dir).reduce(function (n, name) {
+        if (name === '.' || name === '..') {
+            return n;
+        }
+        var path = dir + fs.separator + name;
+        return n + (fs.isDirectory(path) ? countFiles(path) : 1);
+    }, 0);
+}
+
+async_test(function () {
+    var page = require('webpage').create();
+    var before = phantom.diskCacheStats;
+
+    // Same content, served under two URLs
+    page.open(TEST_HTTP_BASE + 'hello.html?first', this.step_func(function (status) {
+        assert_equals(status, 'success');
+
+        page.open(TEST_HTTP_BASE + 'hello.html?second', this.step_func(function (status) {
+            assert_equals(status, 'success');
+            var stats = phantom.diskCacheStats;
+
+            assert_equals(countFiles(CACHE_DIR + '/entries'), 2);
+            assert_equals(countFiles(CACHE_DIR + '/blobs'), 1);
+            assert_equals(stats.blobsWritten - before.blobsWritten, 1);
+            assert_greater_than(stats.bytesSaved, before.bytesSaved);
+
+            page.close();
+            fs.removeTree(CACHE_DIR);
+            this.done();
+        }));
+    }));
+
+}, "identical bodies are stored once");
@@ -0,0 +1,20 @@
+//! phantomjs: --dns-cache-ttl=300
+"use strict";
+
+async_test(function () {
+    var page = require('webpage').create();
+
+    page.open(TEST_HTTP_BASE + 'hello.html', this.step_func(function (status) {
+        assert_equals(status, 'success');
+        assert_own_property(phantom.hostResolverStats.hosts, 'localhost');
+        page.close();
+
+        // The lookup of the cache ends on its own
+        setTimeout(this.step_func_done(function () {
+            var stats = phantom.hostResolverStats;
+            assert_greater_than(stats.hosts.localhost.length, 0);
+            assert_greater_than(stats.lookups, 0);
+        }), 200);
+    }));
+
+}, "hosts used are kept in the DNS cache for --dns-cache-ttl");
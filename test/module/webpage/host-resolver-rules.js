@@ -0,0 +1,21 @@
+//! phantomjs: "--host-resolver-rules=MAP *.phantomjs.test localhost"
+"use strict";
+
+var port = TEST_HTTP_BASE.match(/:(\d+)\//)[1];
+
+async_test(function () {
+    var page = require('webpage').create();
+    var url = 'http://www.phantomjs.test:' + port + '/echo';
+    var before = phantom.hostResolverStats.mapped;
+
+    page.open(url, this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        // The page knows nothing of where the request went
+        assert_equals(page.url, url);
+
+        var desc = JSON.parse(page.plainText);
+        assert_equals(desc.headers.host, 'www.phantomjs.test:' + port);
+        assert_equals(phantom.hostResolverStats.mapped, before + 1);
+        page.close();
+    }));
+}, "requests to mapped hosts go to the host they are mapped to");
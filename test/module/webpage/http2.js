@@ -0,0 +1,37 @@
+"use strict";
+
+async_test(function () {
+    var page = require('webpage').create();
+    var protocols = [];
+
+    assert_equals(page.settings.http2Enabled, false);
+    assert_equals(page.settings.http2CleartextEnabled, false);
+    page.settings.http2Enabled = true;
+
+    page.onResourceReceived = this.step_func(function (response) {
+        if (response.stage === 'end') {
+            protocols.push(response.protocol);
+        }
+    });
+
+    page.open(TEST_HTTPS_BASE, this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        // The test server only has HTTP/1.1, which is then used
+        assert_equals(protocols[0], 'http/1.1');
+        assert_equals(page.networkTimings()[0].protocol, 'http/1.1');
+        page.close();
+    }));
+
+}, "with HTTP/2 allowed, a server without it is still talked to over HTTP/1.1");
+
+async_test(function () {
+    var page = require('webpage').create();
+
+    // Nothing listens there, and WebKit does not block the port: no response ever comes
+    page.open('http://localhost:65534/', this.step_func_done(function (status) {
+        assert_equals(status, 'fail');
+        assert_equals(page.networkTimings()[0].protocol, undefined);
+        page.close();
+    }));
+
+}, "requests which got no response have no protocol");
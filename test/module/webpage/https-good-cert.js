@@ -10,3 +10,20 @@ async_test(function () {
         assert_equals(status, "success");
     }));
 }, "loading an HTTPS webpage");
+
+async_test(function () {
+    // The second page shares the first one's SSL configuration and
+    // resumes its TLS session.
+    var first = require('webpage').create();
+    var url = TEST_HTTPS_BASE;
+    first.open(url, this.step_func(function (status) {
+        assert_equals(status, "success");
+        first.close();
+
+        var second = require('webpage').create();
+        second.onResourceError = this.unreached_func();
+        second.open(url, this.step_func_done(function (status) {
+            assert_equals(status, "success");
+        }));
+    }));
+}, "loading an HTTPS webpage again from another page");
@@ -0,0 +1,27 @@
+//! phantomjs: --memory-cache-size=1024
+"use strict";
+
+var url = TEST_HTTP_BASE + 'logo.html';
+
+async_test(function () {
+    var first = require('webpage').create();
+
+    first.open(url, this.step_func(function (status) {
+        assert_equals(status, 'success');
+        var before = phantom.memoryCacheStats;
+        assert_greater_than(before.count, 0);
+        first.close();
+
+        // Another page, with its own network access manager
+        var second = require('webpage').create();
+        second.open(url, this.step_func_done(function (status) {
+            assert_equals(status, 'success');
+            assert_greater_than(phantom.memoryCacheStats.hits, before.hits);
+
+            second.clearMemoryCache();
+            assert_equals(phantom.memoryCacheStats.count, 0);
+            second.close();
+        }));
+    }));
+
+}, "pages share the responses kept in memory, until clearMemoryCache()");
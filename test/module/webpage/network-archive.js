@@ -0,0 +1,47 @@
+var fs = require('fs');
+var system = require('system');
+var childProcess = require('child_process');
+
+var PAGE_SCRIPT = fs.join(TEST_DIR, 'lib', 'fixtures', 'network-archive-page.js');
+var ARCHIVE = 'network-archive.test';
+
+setup({ test_timeout: 20000 });
+
+function run(mode, urls, cb) {
+    var args = ['--network-archive=' + ARCHIVE, '--network-archive-mode=' + mode, PAGE_SCRIPT].concat(urls);
+    childProcess.execFile(system.executablePath, args, null, function (err, stdout) {
+        cb(stdout.trim().split('\n'));
+    });
+}
+
+async_test(function () {
+    var recorded = TEST_HTTP_BASE + 'logo.html';
+    var notRecorded = TEST_HTTP_BASE + 'hello.html';
+
+    run('record', [recorded], this.step_func(function (lines) {
+        assert_equals(lines.join('|'), 'success Show logo');
+        assert_is_true(fs.exists(ARCHIVE));
+
+        run('replay', [recorded, notRecorded], this.step_func_done(function (lines) {
+            // Only what was recorded is there, without the network
+            assert_equals(lines.join('|'), 'success Show logo|fail');
+            fs.remove(ARCHIVE);
+        }));
+    }));
+
+}, "responses recorded to an archive are replayed from it");
+
+async_test(function () {
+    var url = TEST_HTTP_BASE + 'status?Set-Cookie=replayed%3Dyes';
+
+    run('record', [url], this.step_func(function (lines) {
+        assert_not_equals(lines.indexOf('cookie replayed=yes'), -1);
+
+        // A new process, with no cookies but those of the archive
+        run('replay', [url], this.step_func_done(function (lines) {
+            assert_not_equals(lines.indexOf('cookie replayed=yes'), -1);
+            fs.remove(ARCHIVE);
+        }));
+    }));
+
+}, "cookies set by replayed responses reach the cookie jar");
@@ -0,0 +1,24 @@
+"use strict";
+
+async_test(function () {
+    var page = require('webpage').create();
+    var loaded = false;
+
+    page.settings.networkIdleTime = 400;
+
+    page.onLoadFinished = this.step_func(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(page.title, 'loaded');
+        loaded = true;
+    });
+
+    page.onNetworkIdle = this.step_func_done(function () {
+        assert_is_true(loaded);
+        // The request made after the load is waited for
+        assert_equals(page.title, 'settled');
+        page.close();
+    });
+
+    page.open(TEST_HTTP_BASE + 'network-idle.html');
+
+}, "networkIdle waits for the requests made after loadFinished");
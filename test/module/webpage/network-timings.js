@@ -0,0 +1,49 @@
+"use strict";
+
+var PHASES = ['blocked', 'dns', 'connect', 'ssl', 'send', 'wait', 'receive'];
+
+async_test(function () {
+    var page = require('webpage').create();
+
+    page.open(TEST_HTTP_BASE + 'logo.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+
+        var timings = page.networkTimings();
+        var urls = timings.map(function (entry) { return entry.url; });
+        assert_equals(timings.length, 2);
+        assert_not_equals(urls.indexOf(TEST_HTTP_BASE + 'logo.html'), -1);
+        assert_not_equals(urls.indexOf(TEST_HTTP_BASE + 'logo.png'), -1);
+
+        timings.forEach(function (entry) {
+            var total = 0;
+            assert_equals(entry.method, 'GET');
+            assert_equals(entry.status, 200);
+            assert_instance_of(entry.startedDateTime, Date);
+            PHASES.forEach(function (phase) {
+                assert_greater_than_equal(entry.timings[phase], -1, phase);
+                total += Math.max(entry.timings[phase], 0);
+            });
+            assert_approx_equals(total, entry.time, 1);
+        });
+
+        page.clearNetworkTimings();
+        assert_equals(page.networkTimings().length, 0);
+        page.close();
+    }));
+
+}, "every finished request gets a timing breakdown");
+
+async_test(function () {
+    var page = require('webpage').create();
+
+    page.open(TEST_HTTP_BASE + 'delay?300', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+
+        var timings = page.networkTimings();
+        assert_equals(timings.length, 1);
+        assert_greater_than_equal(timings[0].timings.wait, 250);
+        assert_greater_than_equal(timings[0].time, timings[0].timings.wait);
+        page.close();
+    }));
+
+}, "time spent waiting for the server shows up as wait");
@@ -51,3 +51,37 @@ async_test(function () {
               }));
 
 }, "onResourceTimeout fires after resourceTimeout ms");
+
+async_test(function () {
+    var webpage = require('webpage');
+    var page = webpage.create();
+
+    page.settings.resourceFirstByteTimeout = 50;
+
+    page.onResourceTimeout = this.step_func(function (request) {
+        assert_equals(request.errorCode, 408);
+        assert_equals(request.url, TEST_HTTP_BASE + "delay?1000");
+        assert_equals(request.method, "GET");
+    });
+
+    page.open(TEST_HTTP_BASE + "delay?1000",
+              this.step_func_done(function (s) {
+                  assert_not_equals(s, "success");
+              }));
+
+}, "onResourceTimeout fires when no response comes in resourceFirstByteTimeout ms");
+
+async_test(function () {
+    var webpage = require('webpage');
+    var page = webpage.create();
+
+    page.settings.resourceFirstByteTimeout = 2000;
+    page.settings.resourceTimeout = 2000;
+    page.onResourceTimeout = this.unreached_func();
+
+    page.open(TEST_HTTP_BASE + "delay?10",
+              this.step_func_done(function (s) {
+                  assert_equals(s, "success");
+              }));
+
+}, "resource timeouts are cancelled once the request is done");
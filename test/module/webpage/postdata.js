@@ -40,7 +40,85 @@ async_test(function () {
     };
 
     var page = new WebPage(pageOptions);
+    page.settings.postDataCaptureSize = 1024;
     page.open(TEST_HTTP_BASE + "echo", 'post', postdata);
 
 
 }, "POST data is available in onResourceRequested");
+
+async_test(function () {
+
+    var pageOptions = {
+        onResourceRequested: this.step_func(function (request) {
+            assert_equals(request.postData, undefined);
+        }),
+        onLoadFinished: this.step_func_done(function (status) {
+            validate_echo_response(status, page, "ab=cd");
+        })
+    };
+
+    var page = new WebPage(pageOptions);
+    page.open(TEST_HTTP_BASE + "echo", 'post', "ab=cd");
+
+
+}, "POST data is not read unless postDataCaptureSize is set");
+
+async_test(function () {
+
+    var postdata = "ab=cd\u0000ef=gh";
+    var pageOptions = {
+        onResourceRequested: this.step_func(function (request) {
+            assert_equals(request.postData, postdata.substring(0, 8));
+            assert_equals(request.postDataBase64, undefined);
+        }),
+        onLoadFinished: this.step_func_done(function (status) {
+            validate_echo_response(status, page, postdata);
+        })
+    };
+
+    var page = new WebPage(pageOptions);
+    page.settings.postDataCaptureSize = 8;
+    page.open(TEST_HTTP_BASE + "echo", 'post', postdata);
+
+
+}, "captured POST data is cut at postDataCaptureSize, not at NUL bytes");
+
+async_test(function () {
+
+    var page = new WebPage();
+    page.settings.postDataCaptureSize = 1024;
+
+    page.open(TEST_HTTP_BASE + "hello.html", this.step_func(function (status) {
+        assert_equals(status, 'success');
+
+        page.onResourceRequested = this.step_func_done(function (request) {
+            assert_equals(request.postDataBase64, "AP8B");
+        });
+        page.evaluate(function (url) {
+            var xhr = new XMLHttpRequest();
+            xhr.open('POST', url);
+            xhr.send(new Uint8Array([0, 255, 1]).buffer);
+        }, TEST_HTTP_BASE + "echo");
+    }));
+
+}, "binary POST data is also given in base64");
+
+async_test(function () {
+
+    var postdata = "ab=cd";
+    var pageOptions = {
+        onResourceTimeout: this.step_func(function (request) {
+            assert_equals(request.method, "POST");
+            assert_equals(request.postData, postdata);
+        }),
+        onLoadFinished: this.step_func_done(function (status) {
+            assert_not_equals(status, 'success');
+        })
+    };
+
+    var page = new WebPage(pageOptions);
+    page.settings.postDataCaptureSize = 1024;
+    page.settings.resourceTimeout = 50;
+    page.open(TEST_HTTP_BASE + "delay?1000", 'post', postdata);
+
+}, "POST data is available in onResourceTimeout");
@@ -0,0 +1,74 @@
+var webpage = require('webpage');
+
+var content = '<html><body style="margin:0">' +
+    '<div style="width:300px;height:500px;background:linear-gradient(red,blue)"></div>' +
+    '<div style="width:300px;height:500px;background:linear-gradient(green,yellow)"></div>' +
+    '</body></html>';
+
+// Decode both PNG images in a page and report whether the pixels match.
+function compare_pngs(a, b, callback) {
+    var checker = webpage.create();
+    checker.onCallback = callback;
+    checker.setContent('<html><body></body></html>', 'http://localhost/');
+    checker.evaluate(function (a, b) {
+        function decode(data, done) {
+            var img = new Image();
+            img.onload = function () {
+                var canvas = document.createElement('canvas');
+                canvas.width = img.width;
+                canvas.height = img.height;
+                var ctx = canvas.getContext('2d');
+                ctx.drawImage(img, 0, 0);
+                done(img.width, img.height, ctx.getImageData(0, 0, img.width, img.height).data);
+            };
+            img.onerror = function () {
+                window.callPhantom({ error: 'cannot decode image' });
+            };
+            img.src = 'data:image/png;base64,' + data;
+        }
+        decode(a, function (wa, ha, pa) {
+            decode(b, function (wb, hb, pb) {
+                var same = pa.length === pb.length;
+                for (var i = 0; same && i < pa.length; ++i) {
+                    same = pa[i] === pb[i];
+                }
+                window.callPhantom({ width: wa, height: ha, sameSize: wa === wb && ha === hb, samePixels: same });
+            });
+        });
+    }, a, b);
+}
+
+async_test(function () {
+    var page = webpage.create();
+    page.viewportSize = { width: 300, height: 300 };
+    page.setContent(content, 'http://localhost/');
+
+    var whole = page.renderBase64('png');
+    var strips = page.renderBase64('png', { stripHeight: 64 });
+    assert_not_equals(strips, '');
+
+    compare_pngs(whole, strips, this.step_func_done(function (result) {
+        assert_equals(result.error, undefined);
+        assert_equals(result.width, 300);
+        assert_equals(result.height, 1000);
+        assert_is_true(result.sameSize);
+        assert_is_true(result.samePixels);
+    }));
+}, "rendering in strips gives the same image as rendering in one go");
+
+async_test(function () {
+    var fs = require('fs');
+    var page = webpage.create();
+    var scratch = 'temp_render_strips.png';
+    page.viewportSize = { width: 300, height: 300 };
+    page.setContent(content, 'http://localhost/');
+
+    assert_is_true(page.render(scratch, { stripHeight: 100 }));
+    this.add_cleanup(function () { fs.remove(scratch); });
+    var strips = btoa(fs.read(scratch, 'b'));
+
+    compare_pngs(page.renderBase64('png'), strips, this.step_func_done(function (result) {
+        assert_is_true(result.sameSize);
+        assert_is_true(result.samePixels);
+    }));
+}, "page.render with the stripHeight option");
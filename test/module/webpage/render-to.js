@@ -0,0 +1,114 @@
+var fs = require('fs');
+var webpage = require('webpage');
+
+var content = '<html><body style="margin:0;background:#00ff00">' +
+    '<div style="width:200px;height:150px;background:red"></div></body></html>';
+
+function create_page() {
+    var page = webpage.create();
+    page.viewportSize = { width: 200, height: 150 };
+    page.setContent(content, 'http://localhost/');
+    return page;
+}
+
+test(function () {
+    var page = create_page();
+    var scratch = 'temp_render_to.png';
+    this.add_cleanup(function () { fs.remove(scratch); });
+
+    var file = fs.open(scratch, 'wb');
+    assert_is_true(page.renderTo(file, { format: 'png' }));
+    file.close();
+
+    assert_equals(btoa(fs.read(scratch, 'b')), page.renderBase64('png'));
+}, "page.renderTo writes the same bytes as renderBase64 into a file");
+
+test(function () {
+    var page = create_page();
+    var scratch = 'temp_render_to.jpg';
+    this.add_cleanup(function () { fs.remove(scratch); });
+
+    var file = fs.open(scratch, 'wb');
+    assert_is_true(page.renderTo(file, { format: 'jpg', quality: 50 }));
+    file.close();
+
+    var data = fs.read(scratch, 'b');
+    // JPEG SOI marker
+    assert_equals(data.charCodeAt(0), 0xff);
+    assert_equals(data.charCodeAt(1), 0xd8);
+}, "page.renderTo with format and quality options");
+
+test(function () {
+    var page = create_page();
+    assert_is_true(!page.renderTo(page, { format: 'png' }));
+    assert_is_true(!page.renderTo(null, { format: 'png' }));
+}, "page.renderTo refuses unsupported targets");
+
+async_test(function () {
+    var page = create_page();
+    var client = webpage.create();
+    var server = require('webserver').create();
+    var base;
+    this.add_cleanup(function () { server.close(); });
+
+    var listening = false;
+    for (var port = 1024; port < 32768 && !listening; port++) {
+        listening = server.listen(port, this.step_func(function (request, response) {
+            if (request.url === '/image.png') {
+                response.writeHead(200, { 'Content-Type': 'image/png' });
+                assert_is_true(page.renderTo(response, { format: 'png' }));
+            } else {
+                // The image is then fetched from the same origin
+                response.writeHead(200, { 'Content-Type': 'text/html' });
+                response.write('<html><body></body></html>');
+            }
+            response.close();
+        }));
+    }
+    assert_is_true(listening);
+    base = 'http://localhost:' + server.port;
+
+    client.onCallback = this.step_func_done(function (bytes) {
+        assert_equals(btoa(bytes), page.renderBase64('png'));
+    });
+
+    client.open(base + '/', this.step_func(function (status) {
+        assert_equals(status, 'success');
+        // Asynchronous: the server answers from this thread
+        client.evaluate(function () {
+            var xhr = new XMLHttpRequest();
+            xhr.open('GET', '/image.png');
+            // Each byte as a character, untouched
+            xhr.overrideMimeType('text/plain; charset=x-user-defined');
+            xhr.onload = function () {
+                var data = '';
+                for (var i = 0; i < xhr.responseText.length; i++) {
+                    data += String.fromCharCode(xhr.responseText.charCodeAt(i) & 0xff);
+                }
+                window.callPhantom(data);
+            };
+            xhr.send();
+        });
+    }));
+
+}, "page.renderTo writes the same bytes as renderBase64 into a webserver response");
+
+async_test(function () {
+    var page = create_page();
+    var expected = atob(page.renderBase64('png')).length;
+    var process = require('child_process');
+
+    // Counts the bytes it reads
+    var p = process.spawn(PYTHON, ['-c',
+        'import sys; sys.stdout.write(str(len(getattr(sys.stdin, "buffer", sys.stdin).read())))']);
+    var out = '';
+    p.stdout.on('data', function (data) { out += data; });
+    p.on('exit', this.step_func_done(function (exitCode) {
+        assert_equals(exitCode, 0);
+        assert_equals(Number(out), expected);
+    }));
+
+    assert_is_true(page.renderTo(p.stdin, { format: 'png' }));
+    p.stdin.close();
+
+}, "page.renderTo writes the same bytes as renderBase64 into a child process stdin");
@@ -0,0 +1,59 @@
+//! phantomjs: --coalesce-requests=true
+"use strict";
+
+async_test(function () {
+    var url = TEST_HTTP_BASE + 'delay?500';
+    var before = phantom.requestCoalescerStats;
+    var pages = [require('webpage').create(), require('webpage').create()];
+    var loaded = 0;
+
+    var onLoaded = this.step_func(function (status) {
+        assert_equals(status, 'success');
+        loaded += 1;
+        if (loaded < pages.length) {
+            return;
+        }
+
+        var after = phantom.requestCoalescerStats;
+        assert_equals(after.led, before.led + 1);
+        assert_equals(after.shared, before.shared + 1);
+        assert_equals(pages[1].plainText, pages[0].plainText);
+        pages.forEach(function (page) { page.close(); });
+        this.done();
+    });
+
+    // The second request is made while the first one is waited for
+    pages.forEach(function (page) {
+        page.open(url, onLoaded);
+    });
+
+}, "identical requests going on at once share one download");
+
+async_test(function () {
+    var url = TEST_HTTP_BASE + 'delay?500';
+    var cookiejar = require('cookiejar');
+    var before = phantom.requestCoalescerStats;
+    var pages = [require('webpage').create(), require('webpage').create()];
+    var loaded = 0;
+
+    var onLoaded = this.step_func(function (status) {
+        assert_equals(status, 'success');
+        loaded += 1;
+        if (loaded < pages.length) {
+            return;
+        }
+
+        // Both jars send no cookies
+        var after = phantom.requestCoalescerStats;
+        assert_equals(after.led, before.led + 1);
+        assert_equals(after.shared, before.shared + 1);
+        pages.forEach(function (page) { page.close(); });
+        this.done();
+    });
+
+    pages.forEach(function (page) {
+        page.cookieJar = cookiejar.create();
+        page.open(url, onLoaded);
+    });
+
+}, "pages with cookie jars of their own share downloads sending the same cookies");
@@ -0,0 +1,31 @@
+//! phantomjs: --max-connections=1
+"use strict";
+
+async_test(function () {
+    var page = require('webpage').create();
+    var started = [];
+    var running = 0;
+    var maxRunning = 0;
+
+    page.onResourceReceived = this.step_func(function (response) {
+        var name = response.url.replace(/^.*\//, '');
+        if (response.stage === 'start') {
+            started.push(name);
+            running += 1;
+            maxRunning = Math.max(maxRunning, running);
+        } else if (started.indexOf(name) !== -1) {
+            running -= 1;
+        }
+    });
+
+    assert_equals(page.settings.resourcePriorities[0], 'document');
+
+    page.open(TEST_HTTP_BASE + 'priorities.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(maxRunning, 1);
+        // Waiting behind the first image, the stylesheet goes first
+        assert_less_than(started.indexOf('priorities.css'), started.indexOf('phantomjs.png'));
+        page.close();
+    }));
+
+}, "queued requests start one at a time, stylesheets before images");
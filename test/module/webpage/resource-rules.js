@@ -0,0 +1,72 @@
+var webpage = require('webpage');
+
+function imageLoaded(page) {
+    return page.evaluate(function () {
+        return document.querySelector('img').naturalWidth > 0;
+    });
+}
+
+async_test(function () {
+    var page = webpage.create();
+    var requested = [];
+
+    page.resourceRules = [
+        { action: 'block', url: '*/logo.png', types: ['image'] }
+    ];
+    assert_equals(page.resourceRules.length, 1);
+
+    page.onResourceRequested = this.step_func(function (requestData) {
+        requested.push(requestData.url);
+    });
+
+    page.open(TEST_HTTP_BASE + 'logo.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(requested.length, 1);
+        assert_equals(requested[0], TEST_HTTP_BASE + 'logo.html');
+        assert_is_true(!imageLoaded(page));
+    }));
+
+}, "requests matching a block rule never reach the network nor the page's handlers");
+
+async_test(function () {
+    var page = webpage.create();
+
+    page.resourceRules = [
+        { action: 'allow', url: /logo\.png$/ },
+        { action: 'block', domains: ['localhost'], types: ['image'] }
+    ];
+
+    page.open(TEST_HTTP_BASE + 'logo.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_is_true(imageLoaded(page));
+    }));
+
+}, "the first matching rule wins");
+
+async_test(function () {
+    var page = webpage.create();
+
+    page.resourceRules = [
+        { action: 'block', domains: ['example.com'] }
+    ];
+
+    page.open(TEST_HTTP_BASE + 'logo.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_is_true(imageLoaded(page));
+    }));
+
+}, "domain rules only match their domains");
+
+async_test(function () {
+    var page = webpage.create();
+
+    page.resourceRules = [
+        { action: 'rewrite', url: /^.*\/nothing-here\/(\w+)\.html$/, to: TEST_HTTP_BASE + '\\1.html' }
+    ];
+
+    page.open(TEST_HTTP_BASE + 'nothing-here/hello.html', this.step_func_done(function (status) {
+        assert_equals(status, 'success');
+        assert_equals(page.title, 'Hello');
+    }));
+
+}, "rewrite rules change the requested URL");
@@ -0,0 +1,31 @@
+var webpage = require('webpage');
+
+async_test(function () {
+    var page = webpage.create();
+    var url = TEST_HTTP_BASE + 'logo.html';
+    var received = [];
+
+    page.open(url, this.step_func(function (status) {
+        assert_equals(status, 'success');
+
+        page.onResourceReceived = this.step_func(function (response) {
+            received.push(response.stage + ' ' + response.url);
+            assert_type_of(response.headers, 'object');
+            assert_greater_than(response.headers.length, 0);
+        });
+
+        page.open(url, this.step_func(function (status) {
+            assert_equals(status, 'success');
+            assert_not_equals(received.indexOf('start ' + url), -1);
+            assert_not_equals(received.indexOf('end ' + url), -1);
+
+            page.onResourceReceived = null;
+            received = [];
+            page.open(url, this.step_func_done(function (status) {
+                assert_equals(status, 'success');
+                assert_equals(received.length, 0);
+            }));
+        }));
+    }));
+
+}, "resource signals are reported from the time a handler is set until it is removed");
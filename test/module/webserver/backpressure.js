@@ -0,0 +1,46 @@
+var server, port, request_cb;
+setup(function () {
+    server = require("webserver").create();
+
+    // Find an unused port in the 1024--32767 range; at most one request
+    // may wait for its response at any given time.
+    var opts = { numThreads: 4, queueSize: 8, maxPendingRequests: 1 };
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listenOnPort(i.toString(), opts)) {
+            server.newRequest.connect(function (rq, rs) { return request_cb(rq, rs); });
+            port = server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+},
+      { "test_timeout": 1000 });
+
+async_test(function () {
+    var slow = require("webpage").create();
+    var rejected = require("webpage").create();
+    var base = "http://localhost:" + port;
+    var pending = null;
+    var test = this;
+
+    request_cb = this.step_func(function (request, response) {
+        assert_equals(request.url, "/slow");
+        // Keep the first request waiting, the next one must be turned down
+        pending = response;
+        request_cb = test.unreached_func("request should have been rejected");
+        rejected.open(base + "/rejected");
+    });
+
+    rejected.onResourceReceived = this.step_func(function (resp) {
+        if (resp.stage !== "end") return;
+        assert_equals(resp.status, 503);
+        pending.write("done");
+        pending.close();
+    });
+
+    slow.open(base + "/slow", this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(slow.plainText, "done");
+    }));
+
+}, "requests beyond maxPendingRequests are answered with 503");
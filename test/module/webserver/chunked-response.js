@@ -0,0 +1,72 @@
+var server, base, request_cb;
+setup(function () {
+    server = require("webserver").create();
+
+    // Find an unused port in the 1024--32767 range
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, { keepAlive: true }, function (rq, rs) { return request_cb(rq, rs); })) {
+            base = "http://localhost:" + server.port;
+            return;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+},
+      { "test_timeout": 1000 });
+
+async_test(function () {
+    var page = require("webpage").create();
+    var test = this;
+    var chunked = false;
+
+    request_cb = this.step_func(function (request, response) {
+        response.writeHead(200, {
+            "Content-Type": "text/plain",
+            "Transfer-Encoding": "chunked"
+        });
+        response.flush();
+        response.write("first ");
+        response.write("");
+        response.write("second ");
+        setTimeout(function () {
+            response.write("third");
+            response.close();
+        }, 50);
+        request_cb = test.unreached_func();
+    });
+
+    page.onResourceReceived = this.step_func(function (resp) {
+        if (resp.stage !== "end") return;
+        resp.headers.forEach(function (hdr) {
+            if (hdr.name.toLowerCase() === "transfer-encoding") {
+                chunked = hdr.value.toLowerCase() === "chunked";
+            }
+        });
+    });
+
+    page.open(base + "/", this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "first second third");
+        assert_is_true(chunked);
+    }));
+
+}, "response streamed with chunked transfer encoding");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var test = this;
+
+    request_cb = this.step_func(function (request, response) {
+        response.setEncoding("ISO-8859-1");
+        response.writeHead(200, { "Content-Type": "text/plain;charset=ISO-8859-1" });
+        response.write("café ");
+        response.write("crème");
+        response.close();
+        request_cb = test.unreached_func();
+    });
+
+    page.open(base + "/", this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "café crème");
+    }));
+
+}, "response written with a custom encoding");
@@ -0,0 +1,81 @@
+var webserver = require("webserver");
+var limited, streaming, request_cb;
+
+function listen(server, options) {
+    // Find an unused port in the 1024--32767 range
+    for (var i = 1024; i < 32768; i++) {
+        if (server.listen(i, options, function (rq, rs) { return request_cb(rq, rs); })) {
+            return "http://localhost:" + server.port;
+        }
+    }
+    assert_unreached("unable to find a free TCP port for server tests");
+}
+
+setup(function () {
+    limited = listen(webserver.create(), { maxBodySize: 16 });
+    streaming = listen(webserver.create(), { streamBody: true });
+},
+      { "test_timeout": 1000 });
+
+async_test(function () {
+    var page = require("webpage").create();
+    var test = this;
+
+    request_cb = this.step_func(function (request, response) {
+        assert_equals(request.post, "small");
+        response.write("accepted");
+        response.close();
+        request_cb = test.unreached_func();
+    });
+
+    page.open(limited + "/", "post", "small", this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "accepted");
+    }));
+
+}, "request body within maxBodySize");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var status = 0;
+
+    request_cb = this.unreached_func("request should have been rejected");
+    page.onResourceReceived = function (resp) {
+        if (resp.stage === "end") {
+            status = resp.status;
+        }
+    };
+
+    page.open(limited + "/", "post", "this body is far too large",
+              this.step_func_done(function () {
+        assert_equals(status, 413);
+    }));
+
+}, "request body larger than maxBodySize is rejected with 413");
+
+async_test(function () {
+    var page = require("webpage").create();
+    var body = new Array(20000).join("streamed body é中 ");
+    var test = this;
+
+    request_cb = this.step_func(function (request, response) {
+        var received = "";
+        assert_no_property(request, "post");
+        request.on("data", test.step_func(function (chunk) {
+            received += chunk;
+        }));
+        request.on("end", test.step_func(function () {
+            response.write(received === body ? "match" : "mismatch");
+            response.close();
+        }));
+        request_cb = test.unreached_func();
+    });
+
+    page.open(streaming + "/", "post", body,
+              { "Content-Type": "text/plain;charset=UTF-8" },
+              this.step_func_done(function (status) {
+        assert_equals(status, "success");
+        assert_equals(page.plainText, "match");
+    }));
+
+}, "request body delivered through request.on('data')");